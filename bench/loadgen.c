@@ -0,0 +1,424 @@
+// Load generator for the chat server.
+//
+// Drives one libchatclient session per simulated user from a single epoll
+// loop. Every session scripts the same steps the interactive client does
+// (register, login, create or join a group), pipelined, with many sessions
+// setting up at once. It then sends chat messages at a fixed aggregate rate
+// and measures, for every delivered copy, the time from send to receipt.
+// Each message carries its send time in the text, so latency is end to end
+// through the server's fan-out path.
+
+#include "../client/chatclient.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#define MAX_EVENTS 256
+#define MAX_SAMPLES (16 * 1024 * 1024)
+#define DRAIN_MS 1000
+#define SETUP_WINDOW 256 // Sessions setting up at once; keeps the server's auth queue short
+
+typedef struct {
+    const char *ip;
+    int port;
+    int users;
+    int group_size;
+    long rate;          // Chat messages sent per second, across all users
+    int duration;       // Measured seconds
+    int warmup;         // Seconds before measuring starts
+    int size;           // Chat text length in bytes
+    int server_pid;     // For CPU accounting; 0 to skip
+    const char *prefix; // Username prefix, so reruns against one server don't collide
+    const char *password;
+} loadgen_config_t;
+
+typedef struct {
+    chat_session_t *session;
+    int index;
+    char group_name[MAX_GROUP_NAME_LEN];
+    int logged_in;
+    int in_group;       // Created or joined it
+} bench_conn_t;
+
+typedef struct {
+    uint64_t *latencies; // Nanoseconds, one per delivered copy
+    size_t count;
+    size_t capacity;
+    uint64_t sent;
+    uint64_t delivered;
+} bench_stats_t;
+
+// Shared with the session callbacks
+static bench_stats_t stats;
+static uint64_t measure_start;
+static int setup_running = 0;   // Sessions between connect and their last setup response
+static int setup_failed = -1;   // Index of a user whose setup failed
+static int connection_lost = 0;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s <server_ip> <port_number> [options]\n", program);
+    printf("Options:\n");
+    printf("  --users <count>        Simulated users, one connection each (default 1000)\n");
+    printf("  --group-size <count>   Users per group (default 10)\n");
+    printf("  --rate <msgs/sec>      Chat messages sent per second in total (default 10000)\n");
+    printf("  --duration <seconds>   Measured run time (default 10)\n");
+    printf("  --warmup <seconds>     Unmeasured run time first (default 2)\n");
+    printf("  --size <bytes>         Chat text length (default 64)\n");
+    printf("  --prefix <name>        Username prefix (default bench)\n");
+    printf("  -p <pid>               Server process, to report its CPU time per message\n");
+}
+
+static int parse_config(int argc, char *argv[], loadgen_config_t *config) {
+    static const struct option options[] = {
+        { "users", required_argument, NULL, 'u' },
+        { "group-size", required_argument, NULL, 'g' },
+        { "rate", required_argument, NULL, 'r' },
+        { "duration", required_argument, NULL, 'd' },
+        { "warmup", required_argument, NULL, 'w' },
+        { "size", required_argument, NULL, 's' },
+        { "prefix", required_argument, NULL, 'x' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'u': config->users = atoi(optarg); break;
+            case 'g': config->group_size = atoi(optarg); break;
+            case 'r': config->rate = atol(optarg); break;
+            case 'd': config->duration = atoi(optarg); break;
+            case 'w': config->warmup = atoi(optarg); break;
+            case 's': config->size = atoi(optarg); break;
+            case 'x': config->prefix = optarg; break;
+            case 'p': config->server_pid = atoi(optarg); break;
+            default: return -1;
+        }
+    }
+
+    if (argc - optind != 2) return -1;
+    config->ip = argv[optind];
+    config->port = atoi(argv[optind + 1]);
+
+    if (config->users <= 0 || config->group_size <= 0 || config->rate <= 0 ||
+        config->duration <= 0 || config->warmup < 0 ||
+        config->size < 24 || config->size >= MAX_MESSAGE_LEN) {
+        printf("Invalid option value\n");
+        return -1;
+    }
+    return 0;
+}
+
+// utime + stime of a process, in seconds
+static double process_cpu_seconds(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char line[1024];
+    char *fields = fgets(line, sizeof(line), file) ? strrchr(line, ')') : NULL;
+    fclose(file);
+
+    unsigned long utime, stime;
+    // Fields after the command name, starting at state (field 3); utime and stime are 14 and 15
+    if (!fields || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                          &utime, &stime) != 2) {
+        return -1;
+    }
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static double self_cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static void record_latency(uint64_t latency) {
+    if (stats.count == stats.capacity) {
+        if (stats.capacity >= MAX_SAMPLES) return;
+
+        size_t capacity = stats.capacity ? stats.capacity * 2 : 65536;
+        uint64_t *grown = realloc(stats.latencies, capacity * sizeof(uint64_t));
+        if (!grown) return;
+
+        stats.latencies = grown;
+        stats.capacity = capacity;
+    }
+    stats.latencies[stats.count++] = latency;
+}
+
+// Counts copies of messages sent at or after measure_start
+static void on_message(chat_session_t *session, const message_t *message) {
+    (void)session;
+    if (message->type != MSG_CHAT_MESSAGE) return;
+
+    chat_message_t chat_msg;
+    unsigned long long sent_at;
+    if (chat_decode((const uint8_t*)message->data, message->length, &chat_msg) == 0 &&
+        sscanf(chat_msg.message, "%llu", &sent_at) == 1 && sent_at >= measure_start) {
+        stats.delivered++;
+        record_latency(now_ns() - sent_at);
+    }
+}
+
+static void on_connected(chat_session_t *session, int status) {
+    if (status != 0) {
+        setup_failed = ((bench_conn_t*)chat_session_user_data(session))->index;
+    }
+}
+
+static void on_disconnected(chat_session_t *session) {
+    (void)session;
+    connection_lost = 1;
+}
+
+static void on_login(chat_session_t *session, const message_t *response, void *arg) {
+    (void)session;
+    ((bench_conn_t*)arg)->logged_in = chat_response_success(response);
+}
+
+static void on_group(chat_session_t *session, const message_t *response, void *arg) {
+    (void)session;
+    ((bench_conn_t*)arg)->in_group |= chat_response_success(response);
+}
+
+// The join is always the last step. A returning user who is still in the
+// group is told so right after the login (the session learns the group's ID
+// from it), and the join itself then fails.
+static void on_join(chat_session_t *session, const message_t *response, void *arg) {
+    bench_conn_t *conn = (bench_conn_t*)arg;
+    on_group(session, response, arg);
+    conn->in_group |= chat_session_group_id(session, conn->group_name) != 0;
+    if (!conn->logged_in || !conn->in_group) {
+        setup_failed = conn->index;
+    }
+    setup_running--;
+}
+
+// Connect, then queue every setup step at once; the server answers them in
+// order, so a session's setup takes one round trip after the connect
+static int start_setup(const loadgen_config_t *config, bench_conn_t *conn, int epoll_fd) {
+    static const chat_callbacks_t callbacks = { on_connected, on_message, on_disconnected };
+    char username[MAX_USERNAME_LEN];
+    snprintf(username, sizeof(username), "%s%d", config->prefix, conn->index);
+    snprintf(conn->group_name, sizeof(conn->group_name), "%s_g%d", config->prefix,
+             conn->index / config->group_size);
+
+    conn->session = chat_session_create(&callbacks, conn);
+    if (!conn->session || chat_session_connect(conn->session, config->ip, config->port) < 0) {
+        return -1;
+    }
+
+    // Registering fails harmlessly when a previous run created the user.
+    // The first user of each group creates it, and the join gets everyone
+    // else in. On a rerun the create fails; a restarted server restored the
+    // group without members, so the join succeeds, while a server still up
+    // kept the membership, so the join fails but the user is already in.
+    chat_register(conn->session, username, config->password, NULL, NULL);
+    chat_login(conn->session, username, config->password, on_login, conn);
+    if (conn->index % config->group_size == 0) {
+        chat_create_group(conn->session, conn->group_name, on_group, conn);
+    }
+    if (!chat_join_group(conn->session, conn->group_name, on_join, conn)) {
+        return -1;
+    }
+    setup_running++;
+
+    // Edge-triggered for both directions: the session reads and writes until
+    // the socket would block, so it never needs re-arming
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.ptr = conn;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, chat_session_fd(conn->session), &event);
+}
+
+// Process every session epoll reports; -1 if the server closed one
+static int process_events(int epoll_fd, int timeout_ms) {
+    struct epoll_event events[MAX_EVENTS];
+    int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+    for (int i = 0; i < ready; i++) {
+        chat_session_process(((bench_conn_t*)events[i].data.ptr)->session);
+    }
+    return connection_lost ? -1 : 0;
+}
+
+// Sets every user up, at most SETUP_WINDOW at a time. Group creators go
+// first, so no join reaches the server before its group exists. Returns
+// the index of a user whose setup failed, or -1.
+static int setup_users(const loadgen_config_t *config, bench_conn_t *conns, int epoll_fd) {
+    int *order = malloc(config->users * sizeof(int));
+    if (!order) return 0;
+
+    int creators = 0;
+    for (int i = 0; i < config->users; i += config->group_size) {
+        order[creators++] = i;
+    }
+    int count = creators;
+    for (int i = 0; i < config->users; i++) {
+        if (i % config->group_size != 0) {
+            order[count++] = i;
+        }
+    }
+
+    int started = 0;
+    int failed = -1;
+    while (failed < 0 && (started < config->users || setup_running > 0)) {
+        // Members wait at the boundary until every creator is done
+        while (started < config->users && setup_running < SETUP_WINDOW &&
+               (started != creators || setup_running == 0)) {
+            bench_conn_t *conn = &conns[order[started++]];
+            if (start_setup(config, conn, epoll_fd) < 0) {
+                failed = conn->index;
+                break;
+            }
+        }
+
+        if (failed < 0 && process_events(epoll_fd, 100) < 0) {
+            failed = 0;
+        }
+        if (setup_failed >= 0) {
+            failed = setup_failed;
+        }
+    }
+    free(order);
+    return failed;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const bench_stats_t *stats, double fraction) {
+    if (stats->count == 0) return 0;
+
+    size_t index = (size_t)(fraction * (stats->count - 1));
+    return stats->latencies[index] / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    loadgen_config_t config = { NULL, 0, 1000, 10, 10000, 10, 2, 64, 0, "bench", "benchpw" };
+    if (parse_config(argc, argv, &config) < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    raise_fd_limit();
+
+    bench_conn_t *conns = calloc(config.users, sizeof(bench_conn_t));
+    int epoll_fd = epoll_create1(0);
+    if (!conns || epoll_fd < 0) {
+        perror("Failed to initialize");
+        return 1;
+    }
+
+    for (int i = 0; i < config.users; i++) {
+        conns[i].index = i;
+    }
+    uint64_t setup_start = now_ns();
+    int failed = setup_users(&config, conns, epoll_fd);
+
+    if (failed >= 0) {
+        fprintf(stderr, "Setup failed for user %d\n", failed);
+        return 1;
+    }
+    printf("%d users connected in groups of %d in %.2fs; sending %ld msgs/sec\n",
+           config.users, config.group_size, (now_ns() - setup_start) / 1e9, config.rate);
+    fflush(stdout);
+
+    // Filler text after the timestamp, so messages have the requested size
+    char text[MAX_MESSAGE_LEN];
+    memset(text, 'x', sizeof(text));
+
+    uint64_t interval = 1000000000ull / config.rate;
+    uint64_t start = now_ns();
+    measure_start = start + (uint64_t)config.warmup * 1000000000ull;
+    uint64_t measure_end = measure_start + (uint64_t)config.duration * 1000000000ull;
+    uint64_t drain_end = measure_end + DRAIN_MS * 1000000ull;
+    uint64_t next_send = start;
+    int next_sender = 0;
+    int measuring = 0;
+    double server_cpu_start = 0, self_cpu_start = 0;
+    while (1) {
+        uint64_t now = now_ns();
+        if (now >= drain_end) break;
+
+        if (!measuring && now >= measure_start) {
+            measuring = 1;
+            server_cpu_start = config.server_pid ? process_cpu_seconds(config.server_pid) : 0;
+            self_cpu_start = self_cpu_seconds();
+        }
+
+        // Open loop: send everything that is due, whatever the server's pace
+        while (now < measure_end && next_send <= now) {
+            int written = snprintf(text, sizeof(text), "%llu ", (unsigned long long)now_ns());
+            text[written] = 'x';
+            text[config.size] = '\0';
+
+            if (!chat_send_message(conns[next_sender].session, conns[next_sender].group_name, text)) {
+                fprintf(stderr, "Send failed\n");
+                return 1;
+            }
+            if (now >= measure_start) stats.sent++;
+            next_sender = (next_sender + 1) % config.users;
+            next_send += interval;
+        }
+
+        uint64_t wake = now < measure_end ? next_send : drain_end;
+        int timeout_ms = wake > now ? (int)((wake - now) / 1000000) : 0;
+        if (process_events(epoll_fd, timeout_ms) < 0) {
+            fprintf(stderr, "Server closed a connection\n");
+            return 1;
+        }
+    }
+
+    double server_cpu = config.server_pid ? process_cpu_seconds(config.server_pid) - server_cpu_start : 0;
+    double self_cpu = self_cpu_seconds() - self_cpu_start;
+
+    qsort(stats.latencies, stats.count, sizeof(uint64_t), compare_u64);
+
+    printf("sent           %llu msgs (%.0f msgs/sec)\n",
+           (unsigned long long)stats.sent, stats.sent / (double)config.duration);
+    printf("delivered      %llu msgs (%.0f msgs/sec)\n",
+           (unsigned long long)stats.delivered, stats.delivered / (double)config.duration);
+    printf("latency p50    %.1f us\n", percentile_us(&stats, 0.50));
+    printf("latency p99    %.1f us\n", percentile_us(&stats, 0.99));
+    printf("latency p999   %.1f us\n", percentile_us(&stats, 0.999));
+    printf("latency max    %.1f us\n", stats.count ? stats.latencies[stats.count - 1] / 1000.0 : 0);
+    if (config.server_pid && stats.sent && stats.delivered) {
+        printf("server cpu     %.2f us/msg sent, %.2f us/delivery\n",
+               server_cpu * 1e6 / stats.sent, server_cpu * 1e6 / stats.delivered);
+    }
+    printf("loadgen cpu    %.2f s\n", self_cpu);
+
+    for (int i = 0; i < config.users; i++) {
+        chat_session_destroy(conns[i].session);
+    }
+    free(conns);
+    free(stats.latencies);
+    close(epoll_fd);
+    return 0;
+}
@@ -0,0 +1,260 @@
+// Microbenchmarks for the server's data-structure hot paths.
+//
+// Times user_list_find_by_socket, group_list_find_by_name,
+// add_member_to_group and broadcast_message_to_group at populations from 10
+// to 100k, calling the real server code. Results are printed as CSV, one row
+// per (benchmark, population), so runs can be diffed or loaded into a script:
+//
+//   benchmark,n,ops,total_ns,ns_per_op
+//
+// Broadcast writes to real sockets (one socketpair per online member), so its
+// largest population is bounded by the open-file limit; larger sizes are
+// reported with ops 0.
+
+#include "../server/auth.h"
+#include "../server/connection.h"
+#include "../server/network.h"
+#include "../common/list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#define LOOKUP_OPS 1000000
+#define MIN_RUN_NS 200000000ull // Repeat until at least this much time is measured
+#define MAX_POPULATION 100000
+
+typedef struct {
+    const char *name;
+    void (*run)(int n);
+} benchmark_t;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void report(const char *benchmark, int n, uint64_t ops, uint64_t total_ns) {
+    printf("%s,%d,%llu,%llu,%.2f\n", benchmark, n, (unsigned long long)ops,
+           (unsigned long long)total_ns, ops ? (double)total_ns / ops : 0.0);
+    fflush(stdout);
+}
+
+// Keeps the compiler from discarding lookups whose results are otherwise unused
+static volatile uintptr_t sink;
+
+// Deterministic shuffle, so every run probes the same sequence
+static void shuffle(int *values, int count, unsigned seed) {
+    srand(seed);
+    for (int i = count - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+static int* random_indices(int n, int count) {
+    int *indices = malloc(count * sizeof(int));
+    srand(n);
+    for (int i = 0; i < count; i++) {
+        indices[i] = rand() % n;
+    }
+    return indices;
+}
+
+static void bench_find_by_socket(int n) {
+    list_t *users = user_list_create();
+    char name[MAX_USERNAME_LEN];
+    for (int i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "user%d", i);
+        user_list_add(users, create_user(name, i + 3)); // Socket fds start after stdio
+    }
+
+    int *probes = random_indices(n, LOOKUP_OPS);
+    uint64_t start = now_ns();
+    for (int i = 0; i < LOOKUP_OPS; i++) {
+        sink += (uintptr_t)user_list_find_by_socket(users, probes[i] + 3);
+    }
+    report("user_list_find_by_socket", n, LOOKUP_OPS, now_ns() - start);
+
+    free(probes);
+    user_list_destroy(users);
+}
+
+static void bench_find_group_by_name(int n) {
+    list_t *groups = group_list_create();
+    char (*names)[MAX_GROUP_NAME_LEN] = malloc(n * sizeof(*names));
+    for (int i = 0; i < n; i++) {
+        snprintf(names[i], MAX_GROUP_NAME_LEN, "group%d", i);
+        group_list_add(groups, create_group(names[i]));
+    }
+
+    int *probes = random_indices(n, LOOKUP_OPS);
+    uint64_t start = now_ns();
+    for (int i = 0; i < LOOKUP_OPS; i++) {
+        sink += (uintptr_t)group_list_find_by_name(groups, names[probes[i]]);
+    }
+    report("group_list_find_by_name", n, LOOKUP_OPS, now_ns() - start);
+
+    free(probes);
+    free(names);
+    group_list_destroy(groups);
+}
+
+static void bench_add_member(int n) {
+    // Members join in random ID order, as they would in a live group
+    int *ids = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        ids[i] = i + 1;
+    }
+    shuffle(ids, n, n);
+
+    uint64_t ops = 0;
+    uint64_t total = 0;
+    int round = 0;
+    while (total < MIN_RUN_NS) {
+        char name[MAX_GROUP_NAME_LEN];
+        snprintf(name, sizeof(name), "members%d_%d", n, round++);
+        group_t *group = create_group(name);
+
+        uint64_t start = now_ns();
+        for (int i = 0; i < n; i++) {
+            add_member_to_group(group, ids[i]);
+        }
+        total += now_ns() - start;
+        ops += n;
+
+        destroy_group(group);
+    }
+    report("add_member_to_group", n, ops, total);
+    free(ids);
+}
+
+// Fan-out through the real send path. Every online member owns one end of a
+// socketpair; the other ends are drained between broadcasts, outside the timing.
+static void bench_broadcast(int n) {
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if ((rlim_t)n * 2 + 64 > limit.rlim_cur) {
+        report("broadcast_message_to_group", n, 0, 0);
+        return;
+    }
+
+    int *peers = malloc(n * sizeof(int));
+    list_t *users = user_list_create();
+    char name[MAX_GROUP_NAME_LEN];
+    snprintf(name, sizeof(name), "broadcast%d", n);
+    group_t *group = create_group(name);
+
+    for (int i = 0; i < n; i++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
+            perror("socketpair failed");
+            exit(1);
+        }
+        set_socket_nonblocking(pair[0]);
+        set_socket_nonblocking(pair[1]);
+        peers[i] = pair[1];
+
+        char username[MAX_USERNAME_LEN];
+        snprintf(username, sizeof(username), "member%d", i);
+        user_t *user = create_user(username, pair[0]);
+        user->conn_id = connection_create(pair[0])->id;
+        user_list_add(users, user);
+        add_user_to_group(user, group->id);
+        add_member_to_group(group, user->id);
+        add_online_member(group, user);
+    }
+
+    const char *text = "The quick brown fox jumps over the lazy dog";
+    char drain[65536];
+    uint64_t ops = 0;
+    uint64_t total = 0;
+    while (total < MIN_RUN_NS) {
+        uint64_t start = now_ns();
+        broadcast_message_to_group(group, text, strlen(text), "sender");
+        connection_flush_pending();
+        total += now_ns() - start;
+        ops++;
+
+        for (int i = 0; i < n; i++) {
+            while (recv(peers[i], drain, sizeof(drain), 0) > 0) {
+            }
+        }
+    }
+    report("broadcast_message_to_group", n, ops, total);
+
+    for (int i = 0; i < n; i++) {
+        user_t *user = (user_t*)group->online[i];
+        connection_destroy(connection_lookup(user->socket_fd));
+        close(user->socket_fd);
+        close(peers[i]);
+    }
+    destroy_group(group);
+    user_list_destroy(users);
+    free(peers);
+}
+
+static const benchmark_t benchmarks[] = {
+    { "user_list_find_by_socket", bench_find_by_socket },
+    { "group_list_find_by_name", bench_find_group_by_name },
+    { "add_member_to_group", bench_add_member },
+    { "broadcast_message_to_group", bench_broadcast },
+};
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [--max <population>] [--only <benchmark>]\n", program);
+    printf("Populations are 10, 100, ... up to --max (default %d).\n", MAX_POPULATION);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        { "max", required_argument, NULL, 'm' },
+        { "only", required_argument, NULL, 'o' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int max_population = MAX_POPULATION;
+    const char *only = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+            case 'm': max_population = atoi(optarg); break;
+            case 'o': only = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    if (auth_init(NULL) < 0 || timer_wheel_init() < 0 || connection_table_init(1024) < 0) {
+        printf("Failed to initialize\n");
+        return 1;
+    }
+
+    printf("benchmark,n,ops,total_ns,ns_per_op\n");
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        if (only && strcmp(only, benchmarks[b].name) != 0) continue;
+
+        for (int n = 10; n <= max_population; n *= 10) {
+            benchmarks[b].run(n);
+        }
+    }
+
+    connection_table_destroy();
+    timer_wheel_destroy();
+    auth_cleanup();
+    return 0;
+}
@@ -1,95 +1,43 @@
-#include "auth.h"
-#include "network.h"
-#include <stdio.h>
-#include <stdlib.h>
+#include "session.h"
 #include <string.h>
 
-// Client state
-int is_authenticated = 0;
-char current_username[MAX_USERNAME_LEN] = "";
-
-int client_login(int server_socket, const char *username, const char *password) {
+static uint32_t send_auth_request(chat_session_t *session, message_type_t type, const char *username,
+                                  const char *password, chat_response_cb_t callback, void *arg) {
     if (!username || !password) return 0;
     
-    // Create login message
     auth_message_t auth_msg;
+    memset(&auth_msg, 0, sizeof(auth_msg));
     strncpy(auth_msg.username, username, MAX_USERNAME_LEN - 1);
     strncpy(auth_msg.password, password, MAX_PASSWORD_LEN - 1);
     
     message_t message;
-    message.type = MSG_LOGIN;
+    message.type = type;
     message.length = sizeof(auth_message_t);
     memcpy(message.data, &auth_msg, sizeof(auth_message_t));
     
-    // Send login message
-    if (send_message(server_socket, &message) < 0) {
-        printf("Failed to send login message\n");
-        return 0;
-    }
-    
-    // Wait for response
-    message_t response;
-    if (receive_message(server_socket, &response) < 0) {
-        printf("Failed to receive login response\n");
-        return 0;
-    }
-    
-    if (response.type == MSG_LOGIN_RESPONSE) {
-        handle_auth_response(&response);
-        if (is_authenticated) {
-            strncpy(current_username, username, MAX_USERNAME_LEN - 1);
-            current_username[MAX_USERNAME_LEN - 1] = '\0';
-        }
-        return is_authenticated;
-    }
-    
-    return 0;
+    return chat_send_request(session, &message, callback, arg);
 }
 
-int client_register(int server_socket, const char *username, const char *password) {
-    if (!username || !password) return 0;
-    
-    // Create register message
-    auth_message_t auth_msg;
-    strncpy(auth_msg.username, username, MAX_USERNAME_LEN - 1);
-    strncpy(auth_msg.password, password, MAX_PASSWORD_LEN - 1);
-    
-    message_t message;
-    message.type = MSG_REGISTER;
-    message.length = sizeof(auth_message_t);
-    memcpy(message.data, &auth_msg, sizeof(auth_message_t));
-    
-    // Send register message
-    if (send_message(server_socket, &message) < 0) {
-        printf("Failed to send register message\n");
-        return 0;
-    }
-    
-    // Wait for response
-    message_t response;
-    if (receive_message(server_socket, &response) < 0) {
-        printf("Failed to receive register response\n");
-        return 0;
-    }
-    
-    if (response.type == MSG_REGISTER_RESPONSE) {
-        handle_auth_response(&response);
-        return response->success;
+uint32_t chat_login(chat_session_t *session, const char *username, const char *password,
+                    chat_response_cb_t callback, void *arg) {
+    uint32_t request_id = send_auth_request(session, MSG_LOGIN, username, password, callback, arg);
+    if (request_id) {
+        strncpy(session->login_username, username, MAX_USERNAME_LEN - 1);
+        session->login_username[MAX_USERNAME_LEN - 1] = '\0';
     }
-    
-    return 0;
+    return request_id;
+}
+
+uint32_t chat_register(chat_session_t *session, const char *username, const char *password,
+                       chat_response_cb_t callback, void *arg) {
+    // Registering does not log in, so it leaves the session state alone
+    return send_auth_request(session, MSG_REGISTER, username, password, callback, arg);
 }
 
-void handle_auth_response(const message_t *message) {
-    if (message->type == MSG_LOGIN_RESPONSE || message->type == MSG_REGISTER_RESPONSE) {
-        response_message_t *response = (response_message_t*)message->data;
-        
-        if (response->success) {
-            is_authenticated = 1;
-            printf("✓ %s\n", response->message);
-        } else {
-            is_authenticated = 0;
-            printf("✗ %s\n", response->message);
-        }
+void session_auth_response(chat_session_t *session, const message_t *response) {
+    // A refused login leaves an existing one in place
+    if (chat_response_success(response)) {
+        session->authenticated = 1;
+        strcpy(session->username, session->login_username);
     }
 }
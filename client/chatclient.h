@@ -0,0 +1,101 @@
+#ifndef CHATCLIENT_H
+#define CHATCLIENT_H
+
+#include <stdint.h>
+#include "../common/protocol.h"
+#include "../common/codec.h"
+
+// libchatclient: the client side of the chat protocol, one session per
+// connection and no global state, so a process can drive any number of
+// sessions from its own event loop.
+//
+// Nothing blocks (apart from chat_session_wait). Connecting, sending and
+// receiving only progress inside chat_session_process, which the caller
+// invokes whenever the session's fd is ready. The fd can be watched with
+// poll() for chat_session_events(), or registered once with epoll as
+// EPOLLIN | EPOLLOUT | EPOLLET: chat_session_process reads and writes until
+// the socket would block. Requests may be issued before the connection is
+// up; they are queued and go out once it is.
+//
+// Callbacks run from inside chat_session_process (or chat_session_wait).
+// They may issue requests or close the session, but must not destroy it.
+
+typedef struct chat_session chat_session_t;
+
+typedef struct {
+    // The connect finished; status is 0 or an errno value (the session is then closed)
+    void (*connected)(chat_session_t *session, int status);
+    // A frame that answers no request: chat traffic, offline backlog, history batches
+    void (*message)(chat_session_t *session, const message_t *message);
+    // The server closed the connection or it failed; requests in flight are dropped
+    void (*disconnected)(chat_session_t *session);
+} chat_callbacks_t;
+
+// Runs with the response to a request; arg is what the request was sent with
+typedef void (*chat_response_cb_t)(chat_session_t *session, const message_t *response, void *arg);
+
+#define CHAT_MAX_PENDING 64 // Requests one session can have in flight
+
+// Session lifecycle. Any callback may be NULL.
+chat_session_t* chat_session_create(const chat_callbacks_t *callbacks, void *user_data);
+void chat_session_destroy(chat_session_t *session);
+void* chat_session_user_data(const chat_session_t *session);
+// Starts a non-blocking connect; returns 0, or -1 if it failed outright
+int chat_session_connect(chat_session_t *session, const char *server_ip, int port);
+// Closes the connection without calling disconnected; the session can connect again
+void chat_session_close(chat_session_t *session);
+
+// Event loop integration
+int chat_session_fd(const chat_session_t *session);       // -1 while not connected
+short chat_session_events(const chat_session_t *session); // poll() events to wait for
+// Does whatever the socket allows and runs the callbacks; -1 once the session is closed
+int chat_session_process(chat_session_t *session);
+// Blocking helper: processes the session until the request has been answered; -1 on disconnect
+int chat_session_wait(chat_session_t *session, uint32_t request_id);
+
+// Session state
+int chat_session_connected(const chat_session_t *session);
+int chat_session_authenticated(const chat_session_t *session);
+const char* chat_session_username(const chat_session_t *session); // "" until logged in
+int chat_session_pending(const chat_session_t *session);          // Requests in flight
+// Chat names groups by ID. The session learns them from group responses
+// (join, create, and the list a returning user gets after login) and
+// forgets a group once leaving it succeeds; 0 or NULL for a group it does
+// not know. Decode chat frames with chat_decode.
+uint32_t chat_session_group_id(const chat_session_t *session, const char *group_name);
+const char* chat_session_group_name(const chat_session_t *session, uint32_t group_id);
+
+// Requests. Each returns its request id, or 0 if it could not be queued
+// (not connected, or CHAT_MAX_PENDING already in flight). callback may be NULL.
+uint32_t chat_send_request(chat_session_t *session, message_t *message,
+                           chat_response_cb_t callback, void *arg);
+uint32_t chat_login(chat_session_t *session, const char *username, const char *password,
+                    chat_response_cb_t callback, void *arg);
+uint32_t chat_register(chat_session_t *session, const char *username, const char *password,
+                       chat_response_cb_t callback, void *arg);
+uint32_t chat_join_group(chat_session_t *session, const char *group_name,
+                         chat_response_cb_t callback, void *arg);
+uint32_t chat_create_group(chat_session_t *session, const char *group_name,
+                           chat_response_cb_t callback, void *arg);
+uint32_t chat_leave_group(chat_session_t *session, const char *group_name,
+                          chat_response_cb_t callback, void *arg);
+// Stored messages from since_seq on arrive through the message callback,
+// then the MSG_HISTORY_RESPONSE completes the request
+uint32_t chat_fetch_history(chat_session_t *session, const char *group_name, uint64_t since_seq,
+                            chat_response_cb_t callback, void *arg);
+
+// Round trip to the server, answered by a MSG_PONG. The server's own pings
+// are answered by the library and never reach the message callback.
+uint32_t chat_ping(chat_session_t *session, chat_response_cb_t callback, void *arg);
+
+// Chat has no response: the sender's own copy of the broadcast is the acknowledgement.
+// Returns 1 if queued; 0 also if the session does not know the group's ID yet.
+int chat_send_message(chat_session_t *session, const char *group_name, const char *text);
+// The server closes the connection in reply
+void chat_logout(chat_session_t *session);
+
+// Every response payload starts with its success byte (a pong has none and
+// always succeeds); decode the rest with the decoders in common/codec.h
+int chat_response_success(const message_t *response);
+
+#endif // CHATCLIENT_H
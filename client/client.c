@@ -3,22 +3,23 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
-#include <sys/select.h>
-#include "auth.h"
-#include "network.h"
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include "chatclient.h"
 
 #define BUFFER_SIZE 1024
 #define MAX_INPUT 256
 
-static int server_socket = -1;
+static chat_session_t *session = NULL;
 static int running = 1;
 
 void cleanup() {
     printf("\nDisconnecting from server...\n");
-    if (is_authenticated) {
-        logout(server_socket);
+    if (chat_session_authenticated(session)) {
+        chat_logout(session);
     }
-    disconnect_from_server(server_socket);
+    chat_session_destroy(session);
     exit(0);
 }
 
@@ -35,6 +36,7 @@ void print_help() {
     printf("  join <group_name>            - Join an existing group\n");
     printf("  leave <group_name>           - Leave a group\n");
     printf("  send <group_name> <message>  - Send a message to a group\n");
+    printf("  history <group_name> [from]  - Show stored messages, from #from on\n");
     printf("  groups                        - List your groups\n");
     printf("  logout                        - Logout from the server\n");
     printf("  quit                          - Exit the client\n");
@@ -47,16 +49,124 @@ void print_groups() {
     printf("Groups functionality not yet implemented\n");
 }
 
+// Prints whatever the server sent: chat traffic and responses alike
+void print_server_message(const message_t *message) {
+    switch (message->type) {
+        case MSG_CHAT_MESSAGE: {
+            chat_message_t chat_msg;
+            if (chat_decode((const uint8_t*)message->data, message->length, &chat_msg) < 0) {
+                printf("Received a malformed chat message\n");
+                break;
+            }
+            time_t timestamp = (time_t)chat_msg.timestamp;
+            char time_str[26];
+            ctime_r(&timestamp, time_str);
+            time_str[24] = '\0'; // Remove newline
+            
+            const char *group_name = chat_session_group_name(session, chat_msg.group_id);
+            if (group_name) {
+                printf("[%s] #%llu %s in %s: %s\n", time_str, (unsigned long long)chat_msg.seq,
+                       chat_msg.username, group_name, chat_msg.message);
+            } else {
+                printf("[%s] #%llu %s in group %u: %s\n", time_str, (unsigned long long)chat_msg.seq,
+                       chat_msg.username, chat_msg.group_id, chat_msg.message);
+            }
+            break;
+        }
+        case MSG_HISTORY_RESPONSE: {
+            history_response_t resp;
+            if (history_response_decode((const uint8_t*)message->data, message->length, &resp) < 0) {
+                printf("✗ Malformed history response\n");
+            } else if (!resp.success) {
+                printf("✗ No history available for %s\n", resp.group_name);
+            } else if (resp.more) {
+                printf("✓ %u messages from %s; more with: history %s %llu\n", resp.count,
+                       resp.group_name, resp.group_name, (unsigned long long)resp.next_seq);
+            } else {
+                printf("✓ %u messages from %s; up to date\n", resp.count, resp.group_name);
+            }
+            break;
+        }
+        case MSG_GROUP_RESPONSE: {
+            group_response_t resp;
+            if (group_response_decode((const uint8_t*)message->data, message->length, &resp) < 0) {
+                printf("✗ Malformed group response\n");
+            } else {
+                printf("%s %s (%s)\n", resp.success ? "✓" : "✗", resp.message, resp.group_name);
+            }
+            break;
+        }
+        case MSG_LOGIN_RESPONSE:
+        case MSG_REGISTER_RESPONSE: {
+            response_message_t resp;
+            if (response_decode((const uint8_t*)message->data, message->length, &resp) < 0) {
+                printf("✗ Malformed response\n");
+            } else if (resp.success) {
+                printf("✓ %s\n", resp.message);
+            } else {
+                printf("✗ %s\n", resp.message);
+            }
+            break;
+        }
+        default:
+            printf("Received unknown message type: %d\n", message->type);
+            break;
+    }
+    fflush(stdout);
+}
+
+// Session callbacks
+static void on_connected(chat_session_t *s, int status) {
+    (void)s;
+    if (status != 0) {
+        printf("Connection failed: %s\n", strerror(status));
+        running = 0;
+        return;
+    }
+    printf("Connected to TCP Group Chat Server!\n");
+    print_help();
+}
+
+static void on_message(chat_session_t *s, const message_t *message) {
+    (void)s;
+    print_server_message(message);
+}
+
+static void on_disconnected(chat_session_t *s) {
+    (void)s;
+    printf("Server disconnected\n");
+    running = 0;
+}
+
+static void on_response(chat_session_t *s, const message_t *response, void *arg) {
+    (void)s;
+    (void)arg;
+    print_server_message(response);
+}
+
+static void on_login(chat_session_t *s, const message_t *response, void *arg) {
+    on_response(s, response, arg);
+    if (chat_response_success(response)) {
+        printf("Welcome, %s!\n", chat_session_username(s));
+    }
+}
+
+static void on_register(chat_session_t *s, const message_t *response, void *arg) {
+    on_response(s, response, arg);
+    if (chat_response_success(response)) {
+        printf("Registration successful! You can now login.\n");
+    }
+}
+
 void handle_user_input(const char *input) {
     char command[MAX_INPUT];
     char arg1[MAX_INPUT];
     char arg2[MAX_INPUT];
-    char message[MAX_INPUT];
     
     if (sscanf(input, "%s %s %s", command, arg1, arg2) >= 2) {
         if (strcmp(command, "login") == 0) {
-            if (is_authenticated) {
-                printf("Already logged in as %s\n", current_username);
+            if (chat_session_authenticated(session)) {
+                printf("Already logged in as %s\n", chat_session_username(session));
                 return;
             }
             
@@ -64,8 +174,8 @@ void handle_user_input(const char *input) {
             printf("Enter password: ");
             if (fgets(password, sizeof(password), stdin)) {
                 password[strcspn(password, "\n")] = 0;
-                if (client_login(server_socket, arg1, password)) {
-                    printf("Welcome, %s!\n", current_username);
+                if (!chat_login(session, arg1, password, on_login, NULL)) {
+                    printf("Failed to send login message\n");
                 }
             }
         }
@@ -74,34 +184,52 @@ void handle_user_input(const char *input) {
             printf("Enter password: ");
             if (fgets(password, sizeof(password), stdin)) {
                 password[strcspn(password, "\n")] = 0;
-                if (client_register(server_socket, arg1, password)) {
-                    printf("Registration successful! You can now login.\n");
+                if (!chat_register(session, arg1, password, on_register, NULL)) {
+                    printf("Failed to send register message\n");
                 }
             }
         }
         else if (strcmp(command, "create") == 0) {
-            if (!is_authenticated) {
+            if (!chat_session_authenticated(session)) {
                 printf("Please login first\n");
                 return;
             }
-            create_group(server_socket, arg1);
+            if (!chat_create_group(session, arg1, on_response, NULL)) {
+                printf("Failed to send create group message\n");
+            }
         }
         else if (strcmp(command, "join") == 0) {
-            if (!is_authenticated) {
+            if (!chat_session_authenticated(session)) {
                 printf("Please login first\n");
                 return;
             }
-            join_group(server_socket, arg1);
+            if (!chat_join_group(session, arg1, on_response, NULL)) {
+                printf("Failed to send join group message\n");
+            }
         }
         else if (strcmp(command, "leave") == 0) {
-            if (!is_authenticated) {
+            if (!chat_session_authenticated(session)) {
                 printf("Please login first\n");
                 return;
             }
-            leave_group(server_socket, arg1);
+            if (!chat_leave_group(session, arg1, on_response, NULL)) {
+                printf("Failed to send leave group message\n");
+            }
+        }
+        else if (strcmp(command, "history") == 0) {
+            if (!chat_session_authenticated(session)) {
+                printf("Please login first\n");
+                return;
+            }
+            
+            unsigned long long since = 1;
+            sscanf(input, "%*s %*s %llu", &since);
+            if (!chat_fetch_history(session, arg1, since, on_response, NULL)) {
+                printf("Failed to send history request\n");
+            }
         }
         else if (strcmp(command, "send") == 0) {
-            if (!is_authenticated) {
+            if (!chat_session_authenticated(session)) {
                 printf("Please login first\n");
                 return;
             }
@@ -111,8 +239,11 @@ void handle_user_input(const char *input) {
             while (*msg_start == ' ') msg_start++;
             
             if (strlen(msg_start) > 0) {
-                send_chat_message(server_socket, arg1, msg_start);
-                printf("Message sent to group %s\n", arg1);
+                if (chat_send_message(session, arg1, msg_start)) {
+                    printf("Message sent to group %s\n", arg1);
+                } else {
+                    printf("Failed to send chat message (join or create %s first)\n", arg1);
+                }
             } else {
                 printf("Please provide a message to send\n");
             }
@@ -123,18 +254,18 @@ void handle_user_input(const char *input) {
     }
     else if (sscanf(input, "%s", command) == 1) {
         if (strcmp(command, "groups") == 0) {
-            if (!is_authenticated) {
+            if (!chat_session_authenticated(session)) {
                 printf("Please login first\n");
                 return;
             }
             print_groups();
         }
         else if (strcmp(command, "logout") == 0) {
-            if (!is_authenticated) {
+            if (!chat_session_authenticated(session)) {
                 printf("Not logged in\n");
                 return;
             }
-            logout(server_socket);
+            chat_logout(session);
             printf("Logged out successfully\n");
         }
         else if (strcmp(command, "quit") == 0 || strcmp(command, "exit") == 0) {
@@ -168,58 +299,50 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
-    // Connect to server
-    server_socket = connect_to_server(server_ip, port);
-    if (server_socket == -1) {
-        printf("Failed to connect to server\n");
+    // Connect to server; the rest happens in the event loop
+    chat_callbacks_t callbacks = { on_connected, on_message, on_disconnected };
+    session = chat_session_create(&callbacks, NULL);
+    if (!session || chat_session_connect(session, server_ip, port) < 0) {
+        perror("Failed to connect to server");
         return 1;
     }
     
-    printf("Connected to TCP Group Chat Server!\n");
-    print_help();
-    
-    // Set up for non-blocking input
-    fd_set read_fds;
     char input_buffer[MAX_INPUT];
     
-    // Main client loop
+    // Main client loop: wait for keyboard input or whatever the session needs
     while (running) {
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
-        FD_SET(server_socket, &read_fds);
+        struct pollfd fds[2];
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[1].fd = chat_session_fd(session);
+        fds[1].events = chat_session_events(session);
         
-        int max_fd = (server_socket > STDIN_FILENO) ? server_socket : STDIN_FILENO;
-        
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-        if (activity < 0) {
+        if (poll(fds, 2, -1) < 0) {
             if (errno == EINTR) {
                 continue; // Interrupted by signal
             }
-            perror("Select failed");
+            perror("Poll failed");
             break;
         }
         
-        // Check for server messages
-        if (FD_ISSET(server_socket, &read_fds)) {
-            message_t message;
-            if (receive_message(server_socket, &message) > 0) {
-                handle_server_message(&message);
-            } else {
-                printf("Server disconnected\n");
-                break;
-            }
+        // Check for server messages (and connect completion)
+        if (fds[1].revents) {
+            chat_session_process(session);
         }
         
         // Check for user input
-        if (FD_ISSET(STDIN_FILENO, &read_fds)) {
+        if (running && (fds[0].revents & (POLLIN | POLLHUP))) {
             if (fgets(input_buffer, sizeof(input_buffer), stdin)) {
                 input_buffer[strcspn(input_buffer, "\n")] = 0; // Remove newline
                 
                 if (strlen(input_buffer) > 0) {
                     handle_user_input(input_buffer);
                 }
+            } else {
+                break; // End of input
             }
         }
+        fflush(stdout);
     }
     
     cleanup();
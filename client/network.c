@@ -1,242 +1,476 @@
-#include "network.h"
-#include "auth.h"
+#include "session.h"
+#include "../common/codec.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <time.h>
 
-int connect_to_server(const char *server_ip, int port) {
-    int client_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_socket == -1) {
-        perror("Failed to create socket");
-        return -1;
+chat_session_t* chat_session_create(const chat_callbacks_t *callbacks, void *user_data) {
+    chat_session_t *session = calloc(1, sizeof(chat_session_t));
+    if (!session) return NULL;
+    
+    session->fd = -1;
+    session->state = SESSION_CLOSED;
+    if (callbacks) {
+        session->callbacks = *callbacks;
     }
+    session->user_data = user_data;
+    session->next_request_id = 1;
+    return session;
+}
+
+void chat_session_destroy(chat_session_t *session) {
+    if (!session) return;
+    
+    chat_session_close(session);
+    free(session->rx);
+    free(session->tx);
+    free(session->groups);
+    free(session);
+}
+
+void* chat_session_user_data(const chat_session_t *session) {
+    return session->user_data;
+}
+
+int chat_session_connect(chat_session_t *session, const char *server_ip, int port) {
+    if (session->state != SESSION_CLOSED) return -1;
     
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
-    
     if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
-        printf("Invalid server IP address\n");
-        close(client_socket);
+        errno = EINVAL;
         return -1;
     }
     
-    if (connect(client_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Connection failed");
-        close(client_socket);
+    if (!session->rx) {
+        session->rx = malloc(sizeof(frame_buffer_t));
+        if (!session->rx) return -1;
+    }
+    frame_buffer_init(session->rx);
+    
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1) return -1;
+    
+    // Even an immediate success is reported from chat_session_process, so
+    // the connected callback always runs from the caller's event loop
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
         return -1;
     }
     
-    printf("Connected to server %s:%d\n", server_ip, port);
-    return client_socket;
+    session->fd = fd;
+    session->state = SESSION_CONNECTING;
+    return 0;
 }
 
-void disconnect_from_server(int server_socket) {
-    if (server_socket > 0) {
-        close(server_socket);
+void chat_session_close(chat_session_t *session) {
+    if (session->fd >= 0) {
+        close(session->fd);
     }
+    session->fd = -1;
+    session->state = SESSION_CLOSED;
+    
+    memset(session->pending, 0, sizeof(session->pending));
+    session->pending_count = 0;
+    session->tx_start = 0;
+    session->tx_end = 0;
+    session->authenticated = 0;
+    session->username[0] = '\0';
+    session->group_count = 0;
 }
 
-int send_message(int server_socket, const message_t *message) {
-    int bytes_sent = send(server_socket, message, sizeof(message_t), 0);
-    if (bytes_sent < 0) {
-        perror("Send failed");
-        return -1;
+// Closes on a failure the caller did not ask for, and says so
+static void session_fail(chat_session_t *session) {
+    chat_session_close(session);
+    if (session->callbacks.disconnected) {
+        session->callbacks.disconnected(session);
     }
-    return bytes_sent;
 }
 
-int receive_message(int server_socket, message_t *message) {
-    int bytes_received = recv(server_socket, message, sizeof(message_t), 0);
-    if (bytes_received <= 0) {
-        if (bytes_received == 0) {
-            printf("Server disconnected\n");
-        } else {
-            perror("Recv failed");
+int chat_session_fd(const chat_session_t *session) {
+    return session->fd;
+}
+
+short chat_session_events(const chat_session_t *session) {
+    if (session->state == SESSION_CLOSED) return 0;
+    
+    short events = POLLIN;
+    if (session->state == SESSION_CONNECTING || session->tx_start < session->tx_end) {
+        events |= POLLOUT;
+    }
+    return events;
+}
+
+int chat_session_connected(const chat_session_t *session) {
+    return session->state == SESSION_CONNECTED;
+}
+
+int chat_session_authenticated(const chat_session_t *session) {
+    return session->authenticated;
+}
+
+const char* chat_session_username(const chat_session_t *session) {
+    return session->username;
+}
+
+int chat_session_pending(const chat_session_t *session) {
+    return session->pending_count;
+}
+
+// Write as much queued output as the socket takes; -1 on a write error
+static int flush_output(chat_session_t *session) {
+    while (session->tx_start < session->tx_end) {
+        ssize_t bytes_sent = send(session->fd, session->tx + session->tx_start,
+                                  session->tx_end - session->tx_start, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (bytes_sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
         }
-        return -1;
+        session->tx_start += bytes_sent;
     }
-    return bytes_received;
+    session->tx_start = 0;
+    session->tx_end = 0;
+    return 0;
 }
 
-int join_group(int server_socket, const char *group_name) {
-    if (!group_name) return 0;
+int session_queue_message(chat_session_t *session, const message_t *message) {
+    if (session->state == SESSION_CLOSED) return -1;
     
-    group_message_t group_msg;
-    strncpy(group_msg.group_name, group_name, MAX_GROUP_NAME_LEN - 1);
-    strncpy(group_msg.username, current_username, MAX_USERNAME_LEN - 1);
-    
-    message_t message;
-    message.type = MSG_JOIN_GROUP;
-    message.length = sizeof(group_message_t);
-    memcpy(message.data, &group_msg, sizeof(group_message_t));
+    // Room for one more frame: reuse written space first, then grow
+    if (session->tx_capacity - session->tx_end < MAX_FRAME_LEN) {
+        size_t queued = session->tx_end - session->tx_start;
+        memmove(session->tx, session->tx + session->tx_start, queued);
+        session->tx_start = 0;
+        session->tx_end = queued;
+        
+        if (session->tx_capacity - queued < MAX_FRAME_LEN) {
+            size_t capacity = session->tx_capacity ? session->tx_capacity * 2 : 2 * MAX_FRAME_LEN;
+            uint8_t *grown = realloc(session->tx, capacity);
+            if (!grown) return -1;
+            session->tx = grown;
+            session->tx_capacity = capacity;
+        }
+    }
+    session->tx_end += frame_encode(message, session->tx + session->tx_end);
     
-    if (send_message(server_socket, &message) < 0) {
-        printf("Failed to send join group message\n");
-        return 0;
+    // Write errors surface as a disconnect from the next chat_session_process
+    if (session->state == SESSION_CONNECTED) {
+        flush_output(session);
+    }
+    return 0;
+}
+
+uint32_t chat_send_request(chat_session_t *session, message_t *message,
+                           chat_response_cb_t callback, void *arg) {
+    uint32_t id = session->next_request_id;
+    pending_request_t *slot = &session->pending[id & (CHAT_MAX_PENDING - 1)];
+    if (slot->id != 0) {
+        return 0; // The request CHAT_MAX_PENDING before this one is still unanswered
     }
     
-    // Wait for response
-    message_t response;
-    if (receive_message(server_socket, &response) < 0) {
+    message->request_id = id;
+    if (session_queue_message(session, message) < 0) {
         return 0;
     }
+    slot->id = id;
+    slot->type = message->type;
+    slot->callback = callback;
+    slot->arg = arg;
+    session->pending_count++;
     
-    if (response.type == MSG_GROUP_RESPONSE) {
-        response_message_t *resp = (response_message_t*)response.data;
-        if (resp->success) {
-            printf("✓ %s\n", resp->message);
-            return 1;
-        } else {
-            printf("✗ %s\n", resp->message);
-            return 0;
+    // 0 means "no request", so skip it when the counter wraps
+    session->next_request_id = id + 1 ? id + 1 : 1;
+    return id;
+}
+
+static session_group_t* find_group(const chat_session_t *session, const char *group_name) {
+    for (uint32_t i = 0; i < session->group_count; i++) {
+        if (strncmp(session->groups[i].name, group_name, MAX_GROUP_NAME_LEN) == 0) {
+            return &session->groups[i];
         }
     }
+    return NULL;
+}
+
+// Remembers the ID a group response names the group by
+static void learn_group(chat_session_t *session, const group_response_t *response) {
+    if (!response->success || response->group_id == 0) return;
     
-    return 0;
+    session_group_t *group = find_group(session, response->group_name);
+    if (!group) {
+        if (session->group_count == session->group_capacity) {
+            uint32_t capacity = session->group_capacity ? session->group_capacity * 2 : 8;
+            session_group_t *grown = realloc(session->groups, capacity * sizeof(session_group_t));
+            if (!grown) return;
+            
+            session->groups = grown;
+            session->group_capacity = capacity;
+        }
+        group = &session->groups[session->group_count++];
+        memset(group->name, 0, MAX_GROUP_NAME_LEN);
+        strncpy(group->name, response->group_name, MAX_GROUP_NAME_LEN - 1);
+    }
+    group->id = response->group_id;
 }
 
-int create_group(int server_socket, const char *group_name) {
-    if (!group_name) return 0;
+// A group the user left can no longer be chatted to
+static void forget_group(chat_session_t *session, const group_response_t *response) {
+    if (!response->success) return;
     
-    group_message_t group_msg;
-    strncpy(group_msg.group_name, group_name, MAX_GROUP_NAME_LEN - 1);
-    strncpy(group_msg.username, current_username, MAX_USERNAME_LEN - 1);
+    session_group_t *group = find_group(session, response->group_name);
+    if (group) {
+        *group = session->groups[--session->group_count];
+    }
+}
+
+uint32_t chat_session_group_id(const chat_session_t *session, const char *group_name) {
+    session_group_t *group = group_name ? find_group(session, group_name) : NULL;
+    return group ? group->id : 0;
+}
+
+const char* chat_session_group_name(const chat_session_t *session, uint32_t group_id) {
+    for (uint32_t i = 0; i < session->group_count; i++) {
+        if (session->groups[i].id == group_id) {
+            return session->groups[i].name;
+        }
+    }
+    return NULL;
+}
+
+static int request_pending(const chat_session_t *session, uint32_t request_id) {
+    return request_id != 0 && session->pending[request_id & (CHAT_MAX_PENDING - 1)].id == request_id;
+}
+
+// Completes the request a frame answers, or hands it to the message callback.
+// The chat frames of a history reply carry its id too, but only the closing
+// MSG_HISTORY_RESPONSE completes it.
+static void dispatch_message(chat_session_t *session, const message_t *message) {
+    // Heartbeats are answered here, so a session stays up as long as its
+    // owner keeps processing it
+    if (message->type == MSG_PING) {
+        message_t pong;
+        pong.type = MSG_PONG;
+        pong.request_id = message->request_id;
+        pong.length = 0;
+        session_queue_message(session, &pong);
+        return;
+    }
+    // Including the unprompted ones that list a returning user's groups
+    if (message->type == MSG_GROUP_RESPONSE) {
+        group_response_t response;
+        if (group_response_decode((const uint8_t*)message->data, message->length, &response) == 0) {
+            if (request_pending(session, message->request_id) &&
+                session->pending[message->request_id & (CHAT_MAX_PENDING - 1)].type == MSG_LEAVE_GROUP) {
+                forget_group(session, &response);
+            } else {
+                learn_group(session, &response);
+            }
+        }
+    }
     
-    message_t message;
-    message.type = MSG_CREATE_GROUP;
-    message.length = sizeof(group_message_t);
-    memcpy(message.data, &group_msg, sizeof(group_message_t));
+    if (message->type != MSG_CHAT_MESSAGE && request_pending(session, message->request_id)) {
+        pending_request_t *slot = &session->pending[message->request_id & (CHAT_MAX_PENDING - 1)];
+        chat_response_cb_t callback = slot->callback;
+        void *arg = slot->arg;
+        slot->id = 0;
+        session->pending_count--;
+        
+        if (message->type == MSG_LOGIN_RESPONSE) {
+            session_auth_response(session, message);
+        }
+        if (callback) {
+            callback(session, message, arg);
+        }
+        return;
+    }
+    if (session->callbacks.message) {
+        session->callbacks.message(session, message);
+    }
+}
+
+// Read until the socket is drained, dispatching every complete frame; -1 on
+// EOF, error or a bad frame
+static int read_input(chat_session_t *session) {
+    while (1) {
+        int bytes_received = frame_buffer_fill(session->rx, session->fd);
+        if (bytes_received == 0) return -1;
+        if (bytes_received < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        
+        message_t message;
+        int status;
+        while ((status = frame_buffer_next(session->rx, &message)) > 0) {
+            dispatch_message(session, &message);
+            if (session->state == SESSION_CLOSED) {
+                return 0; // Closed by a callback
+            }
+        }
+        if (status < 0) return -1;
+    }
+}
+
+// Completes a non-blocking connect once the socket reports it done
+static int finish_connect(chat_session_t *session) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(session->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        error = errno;
+    }
     
-    if (send_message(server_socket, &message) < 0) {
-        printf("Failed to send create group message\n");
-        return 0;
+    if (error == 0) {
+        struct sockaddr_in peer;
+        socklen_t peer_length = sizeof(peer);
+        if (getpeername(session->fd, (struct sockaddr*)&peer, &peer_length) < 0) {
+            if (errno == ENOTCONN) return 0; // Still in progress
+            error = errno;
+        }
     }
     
-    // Wait for response
-    message_t response;
-    if (receive_message(server_socket, &response) < 0) {
-        return 0;
+    if (error != 0) {
+        chat_session_close(session);
+    } else {
+        session->state = SESSION_CONNECTED;
+    }
+    if (session->callbacks.connected) {
+        session->callbacks.connected(session, error);
+    }
+    return error ? -1 : 0;
+}
+
+int chat_session_process(chat_session_t *session) {
+    if (session->state == SESSION_CONNECTING && finish_connect(session) < 0) {
+        return -1;
+    }
+    if (session->state != SESSION_CONNECTED) {
+        return session->state == SESSION_CLOSED ? -1 : 0;
     }
     
-    if (response.type == MSG_GROUP_RESPONSE) {
-        response_message_t *resp = (response_message_t*)response.data;
-        if (resp->success) {
-            printf("✓ %s\n", resp->message);
-            return 1;
-        } else {
-            printf("✗ %s\n", resp->message);
-            return 0;
+    if (flush_output(session) < 0 || read_input(session) < 0) {
+        session_fail(session);
+        return -1;
+    }
+    // Callbacks may have queued more than the socket took
+    if (session->state == SESSION_CONNECTED && flush_output(session) < 0) {
+        session_fail(session);
+    }
+    return session->state == SESSION_CLOSED ? -1 : 0;
+}
+
+int chat_session_wait(chat_session_t *session, uint32_t request_id) {
+    while (request_pending(session, request_id)) {
+        if (session->state == SESSION_CLOSED) return -1;
+        
+        struct pollfd pfd = { session->fd, chat_session_events(session), 0 };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
         }
+        if (chat_session_process(session) < 0) return -1;
     }
-    
     return 0;
 }
 
-int send_chat_message(int server_socket, const char *group_name, const char *message_text) {
-    if (!group_name || !message_text) return 0;
-    
-    chat_message_t chat_msg;
-    strncpy(chat_msg.group_name, group_name, MAX_GROUP_NAME_LEN - 1);
-    strncpy(chat_msg.username, current_username, MAX_USERNAME_LEN - 1);
-    strncpy(chat_msg.message, message_text, MAX_MESSAGE_LEN - 1);
-    chat_msg.timestamp = time(NULL);
-    
-    message_t message;
-    message.type = MSG_CHAT_MESSAGE;
-    message.length = sizeof(chat_message_t);
-    memcpy(message.data, &chat_msg, sizeof(chat_message_t));
-    
-    if (send_message(server_socket, &message) < 0) {
-        printf("Failed to send chat message\n");
-        return 0;
+int chat_response_success(const message_t *response) {
+    if (response->type == MSG_PONG) {
+        return 1;
     }
-    
-    return 1;
+    return response->length > 0 && response->data[0] != 0;
 }
 
-int leave_group(int server_socket, const char *group_name) {
+static uint32_t send_group_request(chat_session_t *session, message_type_t type, const char *group_name,
+                                   chat_response_cb_t callback, void *arg) {
     if (!group_name) return 0;
     
     group_message_t group_msg;
+    memset(&group_msg, 0, sizeof(group_msg));
     strncpy(group_msg.group_name, group_name, MAX_GROUP_NAME_LEN - 1);
-    strncpy(group_msg.username, current_username, MAX_USERNAME_LEN - 1);
+    strncpy(group_msg.username, session->username, MAX_USERNAME_LEN - 1);
     
     message_t message;
-    message.type = MSG_LEAVE_GROUP;
+    message.type = type;
     message.length = sizeof(group_message_t);
     memcpy(message.data, &group_msg, sizeof(group_message_t));
     
-    if (send_message(server_socket, &message) < 0) {
-        printf("Failed to send leave group message\n");
-        return 0;
-    }
+    return chat_send_request(session, &message, callback, arg);
+}
+
+uint32_t chat_join_group(chat_session_t *session, const char *group_name,
+                         chat_response_cb_t callback, void *arg) {
+    return send_group_request(session, MSG_JOIN_GROUP, group_name, callback, arg);
+}
+
+uint32_t chat_create_group(chat_session_t *session, const char *group_name,
+                           chat_response_cb_t callback, void *arg) {
+    return send_group_request(session, MSG_CREATE_GROUP, group_name, callback, arg);
+}
+
+uint32_t chat_leave_group(chat_session_t *session, const char *group_name,
+                          chat_response_cb_t callback, void *arg) {
+    return send_group_request(session, MSG_LEAVE_GROUP, group_name, callback, arg);
+}
+
+uint32_t chat_fetch_history(chat_session_t *session, const char *group_name, uint64_t since_seq,
+                            chat_response_cb_t callback, void *arg) {
+    if (!group_name) return 0;
     
-    // Wait for response
-    message_t response;
-    if (receive_message(server_socket, &response) < 0) {
-        return 0;
-    }
+    history_request_t request;
+    memset(&request, 0, sizeof(request));
+    strncpy(request.group_name, group_name, MAX_GROUP_NAME_LEN - 1);
+    request.since_seq = since_seq;
     
-    if (response.type == MSG_GROUP_RESPONSE) {
-        response_message_t *resp = (response_message_t*)response.data;
-        if (resp->success) {
-            printf("✓ %s\n", resp->message);
-            return 1;
-        } else {
-            printf("✗ %s\n", resp->message);
-            return 0;
-        }
-    }
+    message_t message;
+    message.type = MSG_HISTORY_REQUEST;
+    message.length = history_request_encode(&request, (uint8_t*)message.data);
     
-    return 0;
+    return chat_send_request(session, &message, callback, arg);
 }
 
-void logout(int server_socket) {
+int chat_send_message(chat_session_t *session, const char *group_name, const char *text) {
+    if (!group_name || !text) return 0;
+    
+    uint32_t group_id = chat_session_group_id(session, group_name);
+    if (group_id == 0) return 0;
+    
+    // The server fills in seq and the sender's name
     message_t message;
-    message.type = MSG_LOGOUT;
+    message.type = MSG_CHAT_MESSAGE;
+    message.request_id = 0;
+    size_t prefix_len = chat_encode_prefix(group_id, 0, (uint8_t*)message.data);
+    message.length = prefix_len + chat_encode_body(time(NULL), "", text, strnlen(text, MAX_MESSAGE_LEN - 1),
+                                                   (uint8_t*)message.data + prefix_len);
+    
+    return session_queue_message(session, &message) == 0;
+}
+
+uint32_t chat_ping(chat_session_t *session, chat_response_cb_t callback, void *arg) {
+    message_t message;
+    message.type = MSG_PING;
     message.length = 0;
     
-    send_message(server_socket, &message);
-    is_authenticated = 0;
-    current_username[0] = '\0';
+    return chat_send_request(session, &message, callback, arg);
 }
 
-void handle_server_message(const message_t *message) {
-    switch (message->type) {
-        case MSG_CHAT_MESSAGE: {
-            chat_message_t *chat_msg = (chat_message_t*)message->data;
-            time_t timestamp = chat_msg->timestamp;
-            char time_str[26];
-            ctime_r(&timestamp, time_str);
-            time_str[24] = '\0'; // Remove newline
-            
-            printf("[%s] %s in %s: %s\n", 
-                   time_str, chat_msg->username, chat_msg->group_name, chat_msg->message);
-            break;
-        }
-        case MSG_LOGIN_RESPONSE:
-        case MSG_REGISTER_RESPONSE:
-            handle_auth_response(message);
-            break;
-        case MSG_GROUP_RESPONSE: {
-            response_message_t *resp = (response_message_t*)message->data;
-            if (resp->success) {
-                printf("✓ %s\n", resp->message);
-            } else {
-                printf("✗ %s\n", resp->message);
-            }
-            break;
-        }
-        default:
-            printf("Received unknown message type: %d\n", message->type);
-            break;
-    }
+void chat_logout(chat_session_t *session) {
+    message_t message;
+    message.type = MSG_LOGOUT;
+    message.length = 0;
+    message.request_id = 0;
+    
+    session_queue_message(session, &message);
+    session->authenticated = 0;
+    session->username[0] = '\0';
 }
@@ -0,0 +1,60 @@
+#ifndef CLIENT_SESSION_H
+#define CLIENT_SESSION_H
+
+#include <stddef.h>
+#include "chatclient.h"
+#include "../common/frame.h"
+
+// Library-internal view of a session, shared by network.c and auth.c
+
+typedef enum {
+    SESSION_CLOSED,
+    SESSION_CONNECTING,
+    SESSION_CONNECTED
+} session_state_t;
+
+// A group the server has told us the ID of
+typedef struct {
+    uint32_t id;
+    char name[MAX_GROUP_NAME_LEN];
+} session_group_t;
+
+// A request waiting for its response, in the slot its id maps to
+typedef struct {
+    uint32_t id;                  // 0 when the slot is free
+    message_type_t type;          // Of the request
+    chat_response_cb_t callback;
+    void *arg;
+} pending_request_t;
+
+struct chat_session {
+    int fd;
+    session_state_t state;
+    chat_callbacks_t callbacks;
+    void *user_data;
+
+    frame_buffer_t *rx;           // Allocated on first connect
+    uint8_t *tx;                  // Encoded frames not yet written
+    size_t tx_start;              // First unwritten byte
+    size_t tx_end;
+    size_t tx_capacity;
+
+    pending_request_t pending[CHAT_MAX_PENDING];
+    int pending_count;
+    uint32_t next_request_id;
+
+    int authenticated;
+    char username[MAX_USERNAME_LEN];
+    char login_username[MAX_USERNAME_LEN]; // Becomes username if the login in flight succeeds
+    
+    session_group_t *groups;      // Groups the user is in; IDs last for the connection
+    uint32_t group_count;
+    uint32_t group_capacity;
+};
+
+// Queues a frame (request_id already set); 0, or -1 if the session is closed or out of memory
+int session_queue_message(chat_session_t *session, const message_t *message);
+// Updates the login state from the response to a chat_login (auth.c)
+void session_auth_response(chat_session_t *session, const message_t *response);
+
+#endif // CLIENT_SESSION_H
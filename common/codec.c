@@ -0,0 +1,219 @@
+#include "codec.h"
+#include <string.h>
+#include <arpa/inet.h>
+
+size_t varint_encode(uint64_t value, uint8_t *buf) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        buf[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t)value;
+    return n;
+}
+
+int varint_decode(const uint8_t **pos, const uint8_t *end, uint64_t *value) {
+    const uint8_t *p = *pos;
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return -1;
+
+        uint8_t byte = *p++;
+        if (shift == 63 && (byte & 0x7e)) return -1; // Only bit 63 is left
+
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            *pos = p;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void put_u64(uint64_t value, uint8_t *buf) {
+    uint32_t high = htonl((uint32_t)(value >> 32));
+    uint32_t low = htonl((uint32_t)value);
+    memcpy(buf, &high, sizeof(high));
+    memcpy(buf + 4, &low, sizeof(low));
+}
+
+static uint64_t get_u64(const uint8_t *buf) {
+    uint32_t high, low;
+    memcpy(&high, buf, sizeof(high));
+    memcpy(&low, buf + 4, sizeof(low));
+    return (uint64_t)ntohl(high) << 32 | ntohl(low);
+}
+
+// Length-prefixed string, cut to max bytes
+static size_t put_string(const char *text, size_t len, size_t max, uint8_t *buf) {
+    if (len > max) len = max;
+    size_t n = varint_encode(len, buf);
+    memcpy(buf + n, text, len);
+    return n + len;
+}
+
+// Copies a length-prefixed string into out (capacity bytes, NUL-terminated); -1 if it does not fit
+static int get_string(const uint8_t **pos, const uint8_t *end, char *out, size_t capacity,
+                      uint32_t *out_len) {
+    uint64_t len;
+    if (varint_decode(pos, end, &len) < 0 || len >= capacity || len > (uint64_t)(end - *pos)) {
+        return -1;
+    }
+    memcpy(out, *pos, len);
+    out[len] = '\0';
+    *pos += len;
+    if (out_len) *out_len = (uint32_t)len;
+    return 0;
+}
+
+static size_t varint_len(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static size_t string_len(size_t len, size_t max) {
+    if (len > max) len = max;
+    return varint_len(len) + len;
+}
+
+size_t chat_encoded_len(uint32_t group_id, uint64_t seq, const char *username, size_t text_len) {
+    return varint_len(group_id) + varint_len(seq) + 8 +
+           string_len(strnlen(username, MAX_USERNAME_LEN - 1), MAX_USERNAME_LEN - 1) +
+           string_len(text_len, MAX_MESSAGE_LEN - 1);
+}
+
+size_t chat_encode_prefix(uint32_t group_id, uint64_t seq, uint8_t *buf) {
+    size_t n = varint_encode(group_id, buf);
+    return n + varint_encode(seq, buf + n);
+}
+
+size_t chat_encode_body(int64_t timestamp, const char *username, const char *text, size_t text_len,
+                        uint8_t *buf) {
+    put_u64((uint64_t)timestamp, buf);
+    size_t n = 8;
+    n += put_string(username, strnlen(username, MAX_USERNAME_LEN - 1), MAX_USERNAME_LEN - 1, buf + n);
+    n += put_string(text, text_len, MAX_MESSAGE_LEN - 1, buf + n);
+    return n;
+}
+
+size_t chat_encode(const chat_message_t *chat_msg, uint8_t *buf) {
+    size_t n = chat_encode_prefix(chat_msg->group_id, chat_msg->seq, buf);
+    return n + chat_encode_body(chat_msg->timestamp, chat_msg->username, chat_msg->message,
+                                chat_msg->length, buf + n);
+}
+
+int chat_decode(const uint8_t *payload, uint32_t len, chat_message_t *chat_msg) {
+    const uint8_t *pos = payload;
+    const uint8_t *end = payload + len;
+
+    uint64_t group_id;
+    if (varint_decode(&pos, end, &group_id) < 0 || group_id > UINT32_MAX ||
+        varint_decode(&pos, end, &chat_msg->seq) < 0 || end - pos < 8) {
+        return -1;
+    }
+    chat_msg->group_id = (uint32_t)group_id;
+    chat_msg->timestamp = (int64_t)get_u64(pos);
+    pos += 8;
+
+    if (get_string(&pos, end, chat_msg->username, MAX_USERNAME_LEN, NULL) < 0 ||
+        get_string(&pos, end, chat_msg->message, MAX_MESSAGE_LEN, &chat_msg->length) < 0) {
+        return -1;
+    }
+    return pos == end ? 0 : -1;
+}
+
+size_t response_encode(const response_message_t *response, uint8_t *buf) {
+    buf[0] = response->success ? 1 : 0;
+    return 1 + put_string(response->message, strnlen(response->message, MAX_MESSAGE_LEN - 1),
+                          MAX_MESSAGE_LEN - 1, buf + 1);
+}
+
+int response_decode(const uint8_t *payload, uint32_t len, response_message_t *response) {
+    const uint8_t *pos = payload;
+    const uint8_t *end = payload + len;
+    if (pos == end) return -1;
+
+    response->success = *pos++;
+    if (get_string(&pos, end, response->message, MAX_MESSAGE_LEN, NULL) < 0) {
+        return -1;
+    }
+    return pos == end ? 0 : -1;
+}
+
+size_t group_response_encode(const group_response_t *response, uint8_t *buf) {
+    buf[0] = response->success ? 1 : 0;
+    size_t n = 1;
+    n += varint_encode(response->group_id, buf + n);
+    n += put_string(response->group_name, strnlen(response->group_name, MAX_GROUP_NAME_LEN - 1),
+                    MAX_GROUP_NAME_LEN - 1, buf + n);
+    n += put_string(response->message, strnlen(response->message, MAX_MESSAGE_LEN - 1),
+                    MAX_MESSAGE_LEN - 1, buf + n);
+    return n;
+}
+
+int group_response_decode(const uint8_t *payload, uint32_t len, group_response_t *response) {
+    const uint8_t *pos = payload;
+    const uint8_t *end = payload + len;
+    if (pos == end) return -1;
+
+    response->success = *pos++;
+    uint64_t group_id;
+    if (varint_decode(&pos, end, &group_id) < 0 || group_id > UINT32_MAX ||
+        get_string(&pos, end, response->group_name, MAX_GROUP_NAME_LEN, NULL) < 0 ||
+        get_string(&pos, end, response->message, MAX_MESSAGE_LEN, NULL) < 0) {
+        return -1;
+    }
+    response->group_id = (uint32_t)group_id;
+    return pos == end ? 0 : -1;
+}
+
+size_t history_request_encode(const history_request_t *request, uint8_t *buf) {
+    size_t n = varint_encode(request->since_seq, buf);
+    return n + put_string(request->group_name, strnlen(request->group_name, MAX_GROUP_NAME_LEN - 1),
+                          MAX_GROUP_NAME_LEN - 1, buf + n);
+}
+
+int history_request_decode(const uint8_t *payload, uint32_t len, history_request_t *request) {
+    const uint8_t *pos = payload;
+    const uint8_t *end = payload + len;
+    if (varint_decode(&pos, end, &request->since_seq) < 0 ||
+        get_string(&pos, end, request->group_name, MAX_GROUP_NAME_LEN, NULL) < 0) {
+        return -1;
+    }
+    return pos == end ? 0 : -1;
+}
+
+size_t history_response_encode(const history_response_t *response, uint8_t *buf) {
+    buf[0] = response->success ? 1 : 0;
+    buf[1] = response->more ? 1 : 0;
+    size_t n = 2;
+    n += varint_encode(response->count, buf + n);
+    n += varint_encode(response->next_seq, buf + n);
+    n += put_string(response->group_name, strnlen(response->group_name, MAX_GROUP_NAME_LEN - 1),
+                    MAX_GROUP_NAME_LEN - 1, buf + n);
+    return n;
+}
+
+int history_response_decode(const uint8_t *payload, uint32_t len, history_response_t *response) {
+    const uint8_t *pos = payload;
+    const uint8_t *end = payload + len;
+    if (end - pos < 2) return -1;
+
+    response->success = pos[0];
+    response->more = pos[1];
+    pos += 2;
+
+    uint64_t count;
+    if (varint_decode(&pos, end, &count) < 0 || count > UINT32_MAX ||
+        varint_decode(&pos, end, &response->next_seq) < 0 ||
+        get_string(&pos, end, response->group_name, MAX_GROUP_NAME_LEN, NULL) < 0) {
+        return -1;
+    }
+    response->count = (uint32_t)count;
+    return pos == end ? 0 : -1;
+}
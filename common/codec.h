@@ -0,0 +1,81 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+
+// Compact, byte-order-defined encoding of chat payloads, shared by the
+// server and the client library.
+//
+// MSG_CHAT_MESSAGE payload:
+//   group_id:varint | seq:varint | timestamp:i64 | username_len:varint |
+//   username | text_len:varint | text
+//
+// Varints are unsigned LEB128 (7 bits per byte, low bits first); the
+// timestamp is Unix seconds in network byte order; strings carry no
+// terminator. A client sends seq 0 and an empty username, both of which the
+// server fills in, so "hi" to a group is 14 bytes instead of 83 (and
+// well over 1 KB before bodies were trimmed).
+//
+// The server stores everything after seq as the history record and puts
+// group_id and seq back in front when it replays it (see chat_encode_prefix).
+//
+// MSG_LOGIN_RESPONSE and MSG_REGISTER_RESPONSE payload:
+//   success:u8 | text_len:varint | text
+// MSG_GROUP_RESPONSE payload:
+//   success:u8 | group_id:varint | group_name_len:varint | group_name |
+//   text_len:varint | text
+//
+// MSG_HISTORY_REQUEST payload:
+//   since_seq:varint | group_name_len:varint | group_name
+// MSG_HISTORY_RESPONSE payload:
+//   success:u8 | more:u8 | count:varint | next_seq:varint |
+//   group_name_len:varint | group_name
+
+#define VARINT_MAX_LEN 10       // Bytes for a 64-bit value
+#define CHAT_PREFIX_MAX_LEN 15  // group_id and seq
+// Largest encoded chat payload; fits MAX_PAYLOAD_LEN
+#define CHAT_MAX_ENCODED_LEN (CHAT_PREFIX_MAX_LEN + 8 + 1 + MAX_USERNAME_LEN + 2 + MAX_MESSAGE_LEN)
+#define RESPONSE_MAX_LEN (1 + 2 + MAX_MESSAGE_LEN)
+#define GROUP_RESPONSE_MAX_LEN (1 + 5 + 1 + MAX_GROUP_NAME_LEN + 2 + MAX_MESSAGE_LEN)
+#define HISTORY_REQUEST_MAX_LEN (VARINT_MAX_LEN + 1 + MAX_GROUP_NAME_LEN)
+#define HISTORY_RESPONSE_MAX_LEN (2 + 5 + VARINT_MAX_LEN + 1 + MAX_GROUP_NAME_LEN)
+
+// Varints. varint_decode advances *pos and returns 0, or -1 if the value runs
+// past end or does not fit in 64 bits.
+size_t varint_encode(uint64_t value, uint8_t *buf);
+int varint_decode(const uint8_t **pos, const uint8_t *end, uint64_t *value);
+
+// Whole chat payloads. buf needs CHAT_MAX_ENCODED_LEN bytes; the username
+// and text are cut to fit chat_message_t. chat_decode returns 0, or -1 if the
+// payload is malformed.
+size_t chat_encode(const chat_message_t *chat_msg, uint8_t *buf);
+int chat_decode(const uint8_t *payload, uint32_t len, chat_message_t *chat_msg);
+
+// The two halves of a payload: group_id and seq, then the rest (timestamp,
+// username, text); and chat_encoded_len, the exact size chat_encode_prefix plus
+// chat_encode_body will write, so a payload can be encoded in place
+size_t chat_encoded_len(uint32_t group_id, uint64_t seq, const char *username, size_t text_len);
+size_t chat_encode_prefix(uint32_t group_id, uint64_t seq, uint8_t *buf);
+size_t chat_encode_body(int64_t timestamp, const char *username, const char *text, size_t text_len,
+                        uint8_t *buf);
+
+// Responses to logins, registrations and group requests. Every response
+// payload starts with its success byte. buf needs RESPONSE_MAX_LEN or
+// GROUP_RESPONSE_MAX_LEN bytes; the decoders return 0, or -1 if the payload
+// is malformed.
+size_t response_encode(const response_message_t *response, uint8_t *buf);
+int response_decode(const uint8_t *payload, uint32_t len, response_message_t *response);
+size_t group_response_encode(const group_response_t *response, uint8_t *buf);
+int group_response_decode(const uint8_t *payload, uint32_t len, group_response_t *response);
+
+// History requests and responses. buf needs HISTORY_REQUEST_MAX_LEN or
+// HISTORY_RESPONSE_MAX_LEN bytes; the decoders return 0, or -1 if the
+// payload is malformed.
+size_t history_request_encode(const history_request_t *request, uint8_t *buf);
+int history_request_decode(const uint8_t *payload, uint32_t len, history_request_t *request);
+size_t history_response_encode(const history_response_t *response, uint8_t *buf);
+int history_response_decode(const uint8_t *payload, uint32_t len, history_response_t *response);
+
+#endif // CODEC_H
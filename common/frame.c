@@ -0,0 +1,107 @@
+#include "frame.h"
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+void frame_encode_header(message_type_t type, uint32_t request_id, uint32_t length, uint8_t *buf) {
+    uint16_t flags = 0;
+    uint32_t net_length = htonl(length);
+    uint32_t net_request_id = htonl(request_id);
+
+    buf[0] = PROTOCOL_VERSION;
+    buf[1] = (uint8_t)type;
+    memcpy(buf + 2, &flags, sizeof(flags));
+    memcpy(buf + 4, &net_length, sizeof(net_length));
+    memcpy(buf + 8, &net_request_id, sizeof(net_request_id));
+}
+
+size_t frame_encode(const message_t *message, uint8_t *buf) {
+    uint32_t length = message->length;
+    if (length > MAX_PAYLOAD_LEN) {
+        length = MAX_PAYLOAD_LEN;
+    }
+
+    frame_encode_header(message->type, message->request_id, length, buf);
+    memcpy(buf + FRAME_HEADER_LEN, message->data, length);
+
+    return FRAME_HEADER_LEN + length;
+}
+
+int frame_decode_header(const uint8_t *buf, frame_header_t *header) {
+    uint16_t net_flags;
+    uint32_t net_length;
+    uint32_t net_request_id;
+
+    header->version = buf[0];
+    header->type = buf[1];
+    memcpy(&net_flags, buf + 2, sizeof(net_flags));
+    memcpy(&net_length, buf + 4, sizeof(net_length));
+    memcpy(&net_request_id, buf + 8, sizeof(net_request_id));
+    header->flags = ntohs(net_flags);
+    header->length = ntohl(net_length);
+    header->request_id = ntohl(net_request_id);
+
+    if (header->version != PROTOCOL_VERSION || header->length > MAX_PAYLOAD_LEN) {
+        return -1;
+    }
+    return 0;
+}
+
+void frame_decode_payload(const frame_header_t *header, const uint8_t *payload, message_t *message) {
+    message->type = (message_type_t)header->type;
+    message->length = header->length;
+    message->request_id = header->request_id;
+    memcpy(message->data, payload, header->length);
+
+    // Trailing fields of a trimmed payload read back as empty strings
+    memset(message->data + header->length, 0, MAX_PAYLOAD_LEN - header->length);
+}
+
+void frame_buffer_init(frame_buffer_t *buffer) {
+    buffer->start = 0;
+    buffer->end = 0;
+}
+
+int frame_buffer_fill(frame_buffer_t *buffer, int socket_fd) {
+    // Move a leftover partial frame to the front; it is always shorter than one frame
+    if (buffer->start > 0) {
+        size_t pending = buffer->end - buffer->start;
+        memmove(buffer->data, buffer->data + buffer->start, pending);
+        buffer->start = 0;
+        buffer->end = pending;
+    }
+
+    int bytes_received = recv(socket_fd, buffer->data + buffer->end, FRAME_BUFFER_SIZE - buffer->end, 0);
+    if (bytes_received > 0) {
+        buffer->end += bytes_received;
+    }
+    return bytes_received;
+}
+
+int frame_buffer_next(frame_buffer_t *buffer, message_t *message) {
+    size_t available = buffer->end - buffer->start;
+    if (available < FRAME_HEADER_LEN) {
+        return 0;
+    }
+
+    frame_header_t header;
+    const uint8_t *frame = buffer->data + buffer->start;
+    if (frame_decode_header(frame, &header) < 0) {
+        return -1;
+    }
+    if (available < FRAME_HEADER_LEN + header.length) {
+        return 0;
+    }
+
+    frame_decode_payload(&header, frame + FRAME_HEADER_LEN, message);
+    buffer->start += FRAME_HEADER_LEN + header.length;
+    if (buffer->start == buffer->end) {
+        buffer->start = 0;
+        buffer->end = 0;
+    }
+    return 1;
+}
+
+int frame_buffer_is_empty(const frame_buffer_t *buffer) {
+    return buffer->start == buffer->end;
+}
@@ -0,0 +1,41 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+
+// Largest encoded frame (header plus a full payload)
+#define MAX_FRAME_LEN (FRAME_HEADER_LEN + MAX_PAYLOAD_LEN)
+
+// Receive buffer: room for several frames so one read can pick up a burst
+#define FRAME_BUFFER_SIZE (4 * MAX_FRAME_LEN)
+
+// Per-connection input buffer. Bytes are appended by frame_buffer_fill and
+// complete frames are pulled off the front by frame_buffer_next; a partial
+// frame stays buffered until the rest of it arrives.
+typedef struct {
+    uint8_t data[FRAME_BUFFER_SIZE];
+    size_t start; // First unconsumed byte
+    size_t end;   // One past the last buffered byte
+} frame_buffer_t;
+
+// Frame encoding: writes header and payload into buf (at least MAX_FRAME_LEN bytes).
+// Returns the number of bytes to put on the wire.
+size_t frame_encode(const message_t *message, uint8_t *buf);
+// Header only (FRAME_HEADER_LEN bytes), for callers that place the payload themselves
+void frame_encode_header(message_type_t type, uint32_t request_id, uint32_t length, uint8_t *buf);
+
+// Frame decoding: returns 0 on success, -1 on a bad version or oversized length
+int frame_decode_header(const uint8_t *buf, frame_header_t *header);
+void frame_decode_payload(const frame_header_t *header, const uint8_t *payload, message_t *message);
+
+// Input buffer functions
+void frame_buffer_init(frame_buffer_t *buffer);
+// One recv() into the free space: bytes read, 0 on EOF, -1 on error (errno is kept)
+int frame_buffer_fill(frame_buffer_t *buffer, int socket_fd);
+// 1 if a complete frame was decoded into message, 0 if more bytes are needed, -1 if malformed
+int frame_buffer_next(frame_buffer_t *buffer, message_t *message);
+int frame_buffer_is_empty(const frame_buffer_t *buffer);
+
+#endif // FRAME_H
@@ -0,0 +1,131 @@
+#include "hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HASHMAP_MIN_CAPACITY 16
+
+// Grow once the table is 70% full to keep probe sequences short
+#define HASHMAP_NEEDS_GROW(map) ((map)->count * 10 >= (map)->capacity * 7)
+
+uint32_t hashmap_hash(const char *key) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*key) {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+hashmap_t* hashmap_create(uint32_t initial_capacity) {
+    hashmap_t *map = malloc(sizeof(hashmap_t));
+    if (!map) return NULL;
+
+    uint32_t capacity = HASHMAP_MIN_CAPACITY;
+    while (capacity < initial_capacity) {
+        capacity *= 2;
+    }
+
+    map->entries = calloc(capacity, sizeof(hashmap_entry_t));
+    if (!map->entries) {
+        free(map);
+        return NULL;
+    }
+    map->capacity = capacity;
+    map->count = 0;
+    return map;
+}
+
+void hashmap_destroy(hashmap_t *map) {
+    if (!map) return;
+
+    free(map->entries);
+    free(map);
+}
+
+static hashmap_entry_t* find_slot(const hashmap_t *map, const char *key, uint32_t hash) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t i = hash & mask;
+
+    while (map->entries[i].key) {
+        if (map->entries[i].hash == hash && strcmp(map->entries[i].key, key) == 0) {
+            return &map->entries[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return &map->entries[i]; // Empty slot where the key would go
+}
+
+static int hashmap_grow(hashmap_t *map) {
+    uint32_t old_capacity = map->capacity;
+    hashmap_entry_t *old_entries = map->entries;
+
+    map->entries = calloc(old_capacity * 2, sizeof(hashmap_entry_t));
+    if (!map->entries) {
+        map->entries = old_entries;
+        return 0;
+    }
+    map->capacity = old_capacity * 2;
+
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].key) {
+            *find_slot(map, old_entries[i].key, old_entries[i].hash) = old_entries[i];
+        }
+    }
+    free(old_entries);
+    return 1;
+}
+
+int hashmap_put(hashmap_t *map, const char *key, void *value) {
+    if (!map || !key) return 0;
+
+    if (HASHMAP_NEEDS_GROW(map) && !hashmap_grow(map)) {
+        return 0;
+    }
+
+    uint32_t hash = hashmap_hash(key);
+    hashmap_entry_t *entry = find_slot(map, key, hash);
+    if (!entry->key) {
+        map->count++;
+    }
+    entry->key = key;
+    entry->hash = hash;
+    entry->value = value;
+    return 1;
+}
+
+void* hashmap_get(const hashmap_t *map, const char *key) {
+    if (!map || !key) return NULL;
+
+    hashmap_entry_t *entry = find_slot(map, key, hashmap_hash(key));
+    return entry->key ? entry->value : NULL;
+}
+
+void* hashmap_remove(hashmap_t *map, const char *key) {
+    if (!map || !key) return NULL;
+
+    uint32_t mask = map->capacity - 1;
+    hashmap_entry_t *entry = find_slot(map, key, hashmap_hash(key));
+    if (!entry->key) return NULL;
+
+    void *value = entry->value;
+    uint32_t hole = (uint32_t)(entry - map->entries);
+    map->count--;
+
+    // Backward-shift deletion: pull later entries of the probe run into the
+    // hole so lookups never need tombstones
+    uint32_t i = (hole + 1) & mask;
+    while (map->entries[i].key) {
+        uint32_t home = map->entries[i].hash & mask;
+        // Move the entry if its home slot is not cyclically within (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            map->entries[hole] = map->entries[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    map->entries[hole].key = NULL;
+    map->entries[hole].value = NULL;
+
+    return value;
+}
@@ -0,0 +1,31 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stdint.h>
+
+// Open-addressing (linear probing) hash map keyed by C strings.
+// Keys are not copied: a key must stay valid while its entry is in the map,
+// which holds naturally when the key lives inside the stored value.
+typedef struct {
+    const char *key;   // NULL marks an empty slot
+    uint32_t hash;
+    void *value;
+} hashmap_entry_t;
+
+typedef struct {
+    hashmap_entry_t *entries;
+    uint32_t capacity;  // Always a power of two
+    uint32_t count;
+} hashmap_t;
+
+// Map lifecycle
+hashmap_t* hashmap_create(uint32_t initial_capacity);
+void hashmap_destroy(hashmap_t *map);
+
+// Map operations
+int hashmap_put(hashmap_t *map, const char *key, void *value); // Inserts or replaces; 1 on success
+void* hashmap_get(const hashmap_t *map, const char *key);
+void* hashmap_remove(hashmap_t *map, const char *key);          // Returns the removed value
+uint32_t hashmap_hash(const char *key);
+
+#endif // HASHMAP_H
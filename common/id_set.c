@@ -0,0 +1,83 @@
+#include "id_set.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ID_SET_MIN_CAPACITY 4
+
+void id_set_init(id_set_t *set) {
+    set->ids = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+void id_set_free(id_set_t *set) {
+    free(set->ids);
+    id_set_init(set);
+}
+
+// Index of the first element >= id
+static uint32_t lower_bound(const id_set_t *set, uint32_t id) {
+    uint32_t low = 0;
+    uint32_t high = set->count;
+
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (set->ids[mid] < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int id_set_resize(id_set_t *set, uint32_t capacity) {
+    uint32_t *resized = realloc(set->ids, capacity * sizeof(uint32_t));
+    if (!resized) return 0;
+
+    set->ids = resized;
+    set->capacity = capacity;
+    return 1;
+}
+
+int id_set_add(id_set_t *set, uint32_t id) {
+    uint32_t pos = lower_bound(set, id);
+    if (pos < set->count && set->ids[pos] == id) {
+        return 0;
+    }
+
+    if (set->count == set->capacity) {
+        uint32_t capacity = set->capacity ? set->capacity * 2 : ID_SET_MIN_CAPACITY;
+        if (!id_set_resize(set, capacity)) {
+            return -1;
+        }
+    }
+
+    memmove(&set->ids[pos + 1], &set->ids[pos], (set->count - pos) * sizeof(uint32_t));
+    set->ids[pos] = id;
+    set->count++;
+    return 1;
+}
+
+int id_set_remove(id_set_t *set, uint32_t id) {
+    uint32_t pos = lower_bound(set, id);
+    if (pos >= set->count || set->ids[pos] != id) {
+        return 0;
+    }
+
+    memmove(&set->ids[pos], &set->ids[pos + 1], (set->count - pos - 1) * sizeof(uint32_t));
+    set->count--;
+
+    // Give memory back once the set has shrunk well below its capacity
+    if (set->count == 0) {
+        id_set_free(set);
+    } else if (set->capacity > ID_SET_MIN_CAPACITY && set->count <= set->capacity / 4) {
+        id_set_resize(set, set->capacity / 2);
+    }
+    return 1;
+}
+
+int id_set_contains(const id_set_t *set, uint32_t id) {
+    uint32_t pos = lower_bound(set, id);
+    return pos < set->count && set->ids[pos] == id;
+}
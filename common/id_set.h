@@ -0,0 +1,24 @@
+#ifndef ID_SET_H
+#define ID_SET_H
+
+#include <stdint.h>
+
+// Growable set of interned IDs, kept as a sorted vector. Lookups are a
+// binary search, iteration is a plain array walk, and memory follows the
+// actual membership (the vector grows and shrinks by doubling/halving).
+typedef struct {
+    uint32_t *ids;
+    uint32_t count;
+    uint32_t capacity;
+} id_set_t;
+
+// Set lifecycle (a zeroed id_set_t is a valid empty set)
+void id_set_init(id_set_t *set);
+void id_set_free(id_set_t *set);
+
+// Set operations
+int id_set_add(id_set_t *set, uint32_t id);    // 1 if added, 0 if present, -1 on allocation failure
+int id_set_remove(id_set_t *set, uint32_t id); // 1 if removed, 0 if absent
+int id_set_contains(const id_set_t *set, uint32_t id);
+
+#endif // ID_SET_H
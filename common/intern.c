@@ -0,0 +1,74 @@
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+intern_table_t* intern_table_create() {
+    intern_table_t *table = malloc(sizeof(intern_table_t));
+    if (!table) return NULL;
+
+    table->ids = hashmap_create(64);
+    table->capacity = 64;
+    table->names = calloc(table->capacity, sizeof(char*));
+    table->count = 0;
+
+    if (!table->ids || !table->names) {
+        hashmap_destroy(table->ids);
+        free(table->names);
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+void intern_table_destroy(intern_table_t *table) {
+    if (!table) return;
+
+    for (uint32_t id = 1; id <= table->count; id++) {
+        free(table->names[id]);
+    }
+    free(table->names);
+    hashmap_destroy(table->ids);
+    free(table);
+}
+
+uint32_t intern_lookup(const intern_table_t *table, const char *name) {
+    if (!table || !name) return INVALID_ID;
+
+    // IDs are stored directly in the value pointer
+    return (uint32_t)(uintptr_t)hashmap_get(table->ids, name);
+}
+
+uint32_t intern(intern_table_t *table, const char *name) {
+    uint32_t id = intern_lookup(table, name);
+    if (id != INVALID_ID || !table || !name) {
+        return id;
+    }
+
+    if (table->count + 1 >= table->capacity) {
+        uint32_t capacity = table->capacity * 2;
+        char **grown = realloc(table->names, capacity * sizeof(char*));
+        if (!grown) return INVALID_ID;
+
+        memset(grown + table->capacity, 0, (capacity - table->capacity) * sizeof(char*));
+        table->names = grown;
+        table->capacity = capacity;
+    }
+
+    char *copy = strdup(name);
+    if (!copy) return INVALID_ID;
+
+    id = table->count + 1;
+    // The map keys on the table's own copy, which lives as long as the table
+    if (!hashmap_put(table->ids, copy, (void*)(uintptr_t)id)) {
+        free(copy);
+        return INVALID_ID;
+    }
+    table->names[id] = copy;
+    table->count = id;
+    return id;
+}
+
+const char* intern_name(const intern_table_t *table, uint32_t id) {
+    if (!table || id == INVALID_ID || id > table->count) return NULL;
+    return table->names[id];
+}
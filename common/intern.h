@@ -0,0 +1,31 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include "hashmap.h"
+
+// Invalid/unassigned ID; interned IDs start at 1
+#define INVALID_ID 0
+
+// String-interning table: each distinct name gets a compact, dense 32-bit ID
+// and one shared copy of its text. Names are never removed, so IDs and the
+// returned name pointers stay valid for the table's lifetime.
+typedef struct {
+    hashmap_t *ids;   // name -> ID
+    char **names;     // ID -> name (index 0 unused)
+    uint32_t count;   // Highest assigned ID
+    uint32_t capacity;
+} intern_table_t;
+
+// Table lifecycle
+intern_table_t* intern_table_create();
+void intern_table_destroy(intern_table_t *table);
+
+// Returns the ID for name, assigning a new one if needed; INVALID_ID on failure
+uint32_t intern(intern_table_t *table, const char *name);
+// Returns the ID for name without assigning one; INVALID_ID if unknown
+uint32_t intern_lookup(const intern_table_t *table, const char *name);
+// Returns the interned text for an ID, or NULL
+const char* intern_name(const intern_table_t *table, uint32_t id);
+
+#endif // INTERN_H
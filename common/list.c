@@ -1,8 +1,20 @@
 #include "list.h"
+#include "hashmap.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+pool_t list_node_pool = POOL_INITIALIZER("list_nodes", sizeof(list_node_t));
+
+// Index for user and group lists: hash of names to list nodes, plus a
+// dense array from an integer key to list node (socket fd for users,
+// group ID for groups)
+struct list_index {
+    hashmap_t *by_name;
+    list_node_t **by_key;
+    int key_capacity;
+};
+
 // Generic list functions
 list_t* list_create() {
     list_t *list = malloc(sizeof(list_t));
@@ -10,6 +22,7 @@ list_t* list_create() {
         list->head = NULL;
         list->tail = NULL;
         list->size = 0;
+        list->index = NULL;
     }
     return list;
 }
@@ -20,7 +33,7 @@ void list_destroy(list_t *list) {
     list_node_t *current = list->head;
     while (current) {
         list_node_t *next = current->next;
-        free(current);
+        pool_free(&list_node_pool, current);
         current = next;
     }
     free(list);
@@ -29,10 +42,11 @@ void list_destroy(list_t *list) {
 void list_append(list_t *list, void *data) {
     if (!list) return;
     
-    list_node_t *node = malloc(sizeof(list_node_t));
+    list_node_t *node = pool_alloc(&list_node_pool);
     if (!node) return;
     
     node->data = data;
+    node->prev = list->tail;
     node->next = NULL;
     
     if (list->tail) {
@@ -44,29 +58,34 @@ void list_append(list_t *list, void *data) {
     list->size++;
 }
 
+void list_remove_node(list_t *list, list_node_t *node) {
+    if (!list || !node) return;
+    
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        list->head = node->next;
+    }
+    
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        list->tail = node->prev;
+    }
+    
+    pool_free(&list_node_pool, node);
+    list->size--;
+}
+
 void list_remove(list_t *list, void *data) {
     if (!list || !list->head) return;
     
     list_node_t *current = list->head;
-    list_node_t *prev = NULL;
-    
     while (current) {
         if (current->data == data) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                list->head = current->next;
-            }
-            
-            if (current == list->tail) {
-                list->tail = prev;
-            }
-            
-            free(current);
-            list->size--;
+            list_remove_node(list, current);
             return;
         }
-        prev = current;
         current = current->next;
     }
 }
@@ -102,97 +121,184 @@ int list_is_empty(list_t *list) {
     return list ? (list->size == 0) : 1;
 }
 
-// User list specific functions
-list_t* user_list_create() {
-    return list_create();
+// Index helpers
+static list_index_t* list_index_create() {
+    list_index_t *index = calloc(1, sizeof(list_index_t));
+    if (!index) return NULL;
+    
+    index->by_name = hashmap_create(64);
+    if (!index->by_name) {
+        free(index);
+        return NULL;
+    }
+    
+    index->key_capacity = 64;
+    index->by_key = calloc(index->key_capacity, sizeof(list_node_t*));
+    if (!index->by_key) {
+        hashmap_destroy(index->by_name);
+        free(index);
+        return NULL;
+    }
+    return index;
 }
 
-void user_list_destroy(list_t *list) {
+static void list_index_destroy(list_index_t *index) {
+    if (!index) return;
+    
+    hashmap_destroy(index->by_name);
+    free(index->by_key);
+    free(index);
+}
+
+static int list_index_set_key(list_index_t *index, int key, list_node_t *node) {
+    if (key < 0) return 0;
+    
+    if (key >= index->key_capacity) {
+        int capacity = index->key_capacity * 2;
+        while (capacity <= key) {
+            capacity *= 2;
+        }
+        list_node_t **grown = realloc(index->by_key, capacity * sizeof(list_node_t*));
+        if (!grown) return 0;
+        
+        memset(grown + index->key_capacity, 0,
+               (capacity - index->key_capacity) * sizeof(list_node_t*));
+        index->by_key = grown;
+        index->key_capacity = capacity;
+    }
+    
+    index->by_key[key] = node;
+    return 1;
+}
+
+static list_node_t* list_index_get_key(list_index_t *index, int key) {
+    if (key < 0 || key >= index->key_capacity) return NULL;
+    return index->by_key[key];
+}
+
+static list_t* indexed_list_create() {
+    list_t *list = list_create();
+    if (!list) return NULL;
+    
+    list->index = list_index_create();
+    if (!list->index) {
+        free(list);
+        return NULL;
+    }
+    return list;
+}
+
+static void free_user(void *data) {
+    destroy_user((user_t*)data);
+}
+
+static void free_group(void *data) {
+    destroy_group((group_t*)data);
+}
+
+static void indexed_list_destroy(list_t *list, void (*free_data)(void*)) {
     if (!list) return;
     
     list_node_t *current = list->head;
     while (current) {
         list_node_t *next = current->next;
-        free(current->data);
-        free(current);
+        free_data(current->data);
+        pool_free(&list_node_pool, current);
         current = next;
     }
+    list_index_destroy(list->index);
     free(list);
 }
 
-static int compare_username(void *a, void *b) {
-    user_t *user = (user_t*)a;
-    char *username = (char*)b;
-    return strcmp(user->username, username);
+// User list specific functions
+list_t* user_list_create() {
+    return indexed_list_create();
+}
+
+void user_list_destroy(list_t *list) {
+    indexed_list_destroy(list, free_user);
 }
 
-static int compare_socket(void *a, void *b) {
-    user_t *user = (user_t*)a;
-    int socket_fd = *(int*)b;
-    return user->socket_fd - socket_fd;
+void user_list_add(list_t *list, user_t *user) {
+    if (!list || !user) return;
+    
+    list_append(list, user);
+    if (list->tail && list->tail->data == user) {
+        hashmap_put(list->index->by_name, user->username, list->tail);
+        list_index_set_key(list->index, user->socket_fd, list->tail);
+    }
+}
+
+void user_list_set_socket(list_t *list, user_t *user, int socket_fd) {
+    if (!list || !user) return;
+    
+    list_node_t *node = hashmap_get(list->index->by_name, user->username);
+    if (list_index_get_key(list->index, user->socket_fd) == node) {
+        list_index_set_key(list->index, user->socket_fd, NULL);
+    }
+    
+    user->socket_fd = socket_fd;
+    if (node) {
+        list_index_set_key(list->index, socket_fd, node);
+    }
 }
 
 user_t* user_list_find_by_username(list_t *list, const char *username) {
-    return (user_t*)list_find(list, (void*)username, compare_username);
+    if (!list || !username) return NULL;
+    
+    list_node_t *node = hashmap_get(list->index->by_name, username);
+    return node ? (user_t*)node->data : NULL;
 }
 
 user_t* user_list_find_by_socket(list_t *list, int socket_fd) {
-    return (user_t*)list_find(list, &socket_fd, compare_socket);
+    if (!list) return NULL;
+    
+    list_node_t *node = list_index_get_key(list->index, socket_fd);
+    return node ? (user_t*)node->data : NULL;
 }
 
 void user_list_remove_by_socket(list_t *list, int socket_fd) {
-    if (!list || !list->head) return;
+    if (!list) return;
     
-    list_node_t *current = list->head;
-    list_node_t *prev = NULL;
+    list_node_t *node = list_index_get_key(list->index, socket_fd);
+    if (!node) return;
     
-    while (current) {
-        user_t *user = (user_t*)current->data;
-        if (user->socket_fd == socket_fd) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                list->head = current->next;
-            }
-            
-            if (current == list->tail) {
-                list->tail = prev;
-            }
-            
-            free(user);
-            free(current);
-            list->size--;
-            return;
-        }
-        prev = current;
-        current = current->next;
-    }
+    user_t *user = (user_t*)node->data;
+    list_index_set_key(list->index, socket_fd, NULL);
+    hashmap_remove(list->index->by_name, user->username);
+    list_remove_node(list, node);
+    destroy_user(user);
 }
 
 // Group list specific functions
 list_t* group_list_create() {
-    return list_create();
+    return indexed_list_create();
 }
 
 void group_list_destroy(list_t *list) {
-    if (!list) return;
+    indexed_list_destroy(list, free_group);
+}
+
+void group_list_add(list_t *list, group_t *group) {
+    if (!list || !group) return;
     
-    list_node_t *current = list->head;
-    while (current) {
-        list_node_t *next = current->next;
-        free(current->data);
-        free(current);
-        current = next;
+    list_append(list, group);
+    if (list->tail && list->tail->data == group) {
+        hashmap_put(list->index->by_name, group->name, list->tail);
+        list_index_set_key(list->index, (int)group->id, list->tail);
     }
-    free(list);
 }
 
-static int compare_group_name(void *a, void *b) {
-    group_t *group = (group_t*)a;
-    char *name = (char*)b;
-    return strcmp(group->name, name);
+group_t* group_list_find_by_name(list_t *list, const char *group_name) {
+    if (!list || !group_name) return NULL;
+    
+    list_node_t *node = hashmap_get(list->index->by_name, group_name);
+    return node ? (group_t*)node->data : NULL;
 }
 
-group_t* group_list_find_by_name(list_t *list, const char *group_name) {
-    return (group_t*)list_find(list, (void*)group_name, compare_group_name);
+group_t* group_list_find_by_id(list_t *list, uint32_t group_id) {
+    if (!list) return NULL;
+    
+    list_node_t *node = list_index_get_key(list->index, (int)group_id);
+    return node ? (group_t*)node->data : NULL;
 }
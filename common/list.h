@@ -2,18 +2,27 @@
 #define LIST_H
 
 #include "protocol.h"
+#include "pool.h"
 
 // List node structure
 typedef struct list_node {
     void *data;
+    struct list_node *prev;
     struct list_node *next;
 } list_node_t;
 
+// Every list node comes from here
+extern pool_t list_node_pool;
+
+// Lookup index kept alongside user and group lists (see list.c)
+typedef struct list_index list_index_t;
+
 // List structure
 typedef struct {
     list_node_t *head;
     list_node_t *tail;
     int size;
+    list_index_t *index; // NULL for plain lists
 } list_t;
 
 // Function declarations
@@ -26,15 +35,32 @@ void list_foreach(list_t *list, void (*func)(void*));
 int list_size(list_t *list);
 int list_is_empty(list_t *list);
 
-// Specific list functions for users and groups
+void list_remove_node(list_t *list, list_node_t *node);
+
+// Specific list functions for users and groups.
+// These lists are indexed (hash by name, plus a dense array by socket fd
+// for users and by group ID for groups), so lookups are O(1). Add entries and change a user's socket only
+// through these functions so the index stays in sync; list_append would
+// bypass it.
+// Destroying a list destroys its records too
 list_t* user_list_create();
 void user_list_destroy(list_t *list);
+void user_list_add(list_t *list, user_t *user);
+void user_list_set_socket(list_t *list, user_t *user, int socket_fd);
 user_t* user_list_find_by_username(list_t *list, const char *username);
 user_t* user_list_find_by_socket(list_t *list, int socket_fd);
 void user_list_remove_by_socket(list_t *list, int socket_fd);
 
 list_t* group_list_create();
 void group_list_destroy(list_t *list);
+void group_list_add(list_t *list, group_t *group);
 group_t* group_list_find_by_name(list_t *list, const char *group_name);
+group_t* group_list_find_by_id(list_t *list, uint32_t group_id);
+
+// Free a user or group record (made by create_user or create_group). The
+// server defines these next to its record pools; the list destructors use
+// them too
+void destroy_user(user_t *user);
+void destroy_group(group_t *group);
 
 #endif // LIST_H
@@ -0,0 +1,220 @@
+#include "pool.h"
+#include <stdlib.h>
+
+static __thread int thread_cache_id = -1;
+
+static size_t pool_stride(size_t size) {
+    if (size < sizeof(void*)) {
+        size = sizeof(void*); // Free objects hold the list link
+    }
+    if (size > POOL_CACHE_LINE) {
+        return (size + POOL_CACHE_LINE - 1) & ~(size_t)(POOL_CACHE_LINE - 1);
+    }
+
+    size_t stride = sizeof(void*);
+    while (stride < size) {
+        stride *= 2;
+    }
+    return stride;
+}
+
+// Called with the lock held. The slab's first line holds its list link so
+// the objects after it start on a line boundary.
+static int pool_grow(pool_t *pool, size_t count) {
+    if (!pool->stride) {
+        pool->stride = pool_stride(pool->size);
+    }
+
+    size_t bytes = POOL_CACHE_LINE + count * pool->stride;
+    bytes = (bytes + POOL_CACHE_LINE - 1) & ~(size_t)(POOL_CACHE_LINE - 1);
+    uint8_t *slab = aligned_alloc(POOL_CACHE_LINE, bytes);
+    if (!slab) return -1;
+
+    *(void**)slab = pool->slabs;
+    pool->slabs = slab;
+
+    // Thread the new objects onto the free list, lowest address first
+    uint8_t *objects = slab + POOL_CACHE_LINE;
+    for (size_t i = count; i > 0; i--) {
+        void *object = objects + (i - 1) * pool->stride;
+        *(void**)object = pool->free_list;
+        pool->free_list = object;
+    }
+    pool->capacity += count;
+    return 0;
+}
+
+// Objects sitting in thread caches
+static size_t cached_objects(pool_t *pool) {
+    size_t cached = 0;
+    for (size_t i = 0; i < pool->cache_count; i++) {
+        cached += __atomic_load_n(&pool->caches[i].count, __ATOMIC_RELAXED);
+    }
+    return cached;
+}
+
+// Called with the lock held
+static void update_high_water(pool_t *pool) {
+    size_t in_use = pool->taken - cached_objects(pool);
+    if (in_use > pool->high_water) {
+        pool->high_water = in_use;
+    }
+}
+
+// Take up to count objects off the shared free list, growing it if empty.
+// Called with the lock held; returns how many were taken, linked as a list.
+static size_t take_objects(pool_t *pool, size_t count, void **list) {
+    if (!pool->free_list) {
+        // Grow geometrically, so the number of slabs stays logarithmic
+        size_t grow = pool->capacity ? pool->capacity : 64;
+        if (grow > POOL_MAX_SLAB_OBJECTS) {
+            grow = POOL_MAX_SLAB_OBJECTS;
+        }
+        if (pool_grow(pool, grow) < 0) {
+            return 0;
+        }
+    }
+
+    size_t taken = 0;
+    void *last = NULL;
+    void *object = pool->free_list;
+    while (object && taken < count) {
+        last = object;
+        object = *(void**)object;
+        taken++;
+    }
+    *list = pool->free_list;
+    *(void**)last = NULL;
+    pool->free_list = object;
+    pool->taken += taken;
+    return taken;
+}
+
+int pool_reserve(pool_t *pool, size_t count) {
+    pthread_mutex_lock(&pool->lock);
+    int result = 0;
+    if (pool->capacity < count) {
+        result = pool_grow(pool, count - pool->capacity);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return result;
+}
+
+int pool_set_caches(pool_t *pool, size_t count) {
+    pool_cache_t *caches = aligned_alloc(POOL_CACHE_LINE, count * sizeof(pool_cache_t));
+    if (!caches) return -1;
+
+    for (size_t i = 0; i < count; i++) {
+        caches[i].free_list = NULL;
+        caches[i].count = 0;
+    }
+    pthread_mutex_lock(&pool->lock);
+    free(pool->caches);
+    pool->caches = caches;
+    pool->cache_count = count;
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void pool_destroy(pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    void *slab = pool->slabs;
+    while (slab) {
+        void *next = *(void**)slab;
+        free(slab);
+        slab = next;
+    }
+    free(pool->caches);
+    pool->caches = NULL;
+    pool->cache_count = 0;
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->capacity = 0;
+    pool->taken = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_thread_cache(int id) {
+    thread_cache_id = id;
+}
+
+static pool_cache_t* thread_cache(pool_t *pool) {
+    if (thread_cache_id < 0 || (size_t)thread_cache_id >= pool->cache_count) {
+        return NULL;
+    }
+    return &pool->caches[thread_cache_id];
+}
+
+void* pool_alloc(pool_t *pool) {
+    pool_cache_t *cache = thread_cache(pool);
+    if (!cache) {
+        pthread_mutex_lock(&pool->lock);
+        void *object;
+        if (!take_objects(pool, 1, &object)) {
+            object = NULL;
+        } else {
+            update_high_water(pool);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return object;
+    }
+
+    if (!cache->free_list) {
+        pthread_mutex_lock(&pool->lock);
+        size_t taken = take_objects(pool, POOL_CACHE_BATCH, &cache->free_list);
+        __atomic_store_n(&cache->count, taken, __ATOMIC_RELAXED);
+        update_high_water(pool);
+        pthread_mutex_unlock(&pool->lock);
+        if (!taken) return NULL;
+    }
+
+    void *object = cache->free_list;
+    cache->free_list = *(void**)object;
+    __atomic_store_n(&cache->count, cache->count - 1, __ATOMIC_RELAXED);
+    return object;
+}
+
+void pool_free(pool_t *pool, void *object) {
+    if (!object) return;
+
+    pool_cache_t *cache = thread_cache(pool);
+    if (!cache) {
+        pthread_mutex_lock(&pool->lock);
+        *(void**)object = pool->free_list;
+        pool->free_list = object;
+        pool->taken--;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    *(void**)object = cache->free_list;
+    cache->free_list = object;
+    __atomic_store_n(&cache->count, cache->count + 1, __ATOMIC_RELAXED);
+    if (cache->count < 2 * POOL_CACHE_BATCH) return;
+
+    // Give a batch back so objects freed here can be used by other threads
+    void *first = cache->free_list;
+    void *last = first;
+    for (size_t i = 1; i < POOL_CACHE_BATCH; i++) {
+        last = *(void**)last;
+    }
+    cache->free_list = *(void**)last;
+    __atomic_store_n(&cache->count, cache->count - POOL_CACHE_BATCH, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&pool->lock);
+    *(void**)last = pool->free_list;
+    pool->free_list = first;
+    pool->taken -= POOL_CACHE_BATCH;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_get_stats(pool_t *pool, pool_stats_t *stats) {
+    pthread_mutex_lock(&pool->lock);
+    update_high_water(pool);
+    stats->name = pool->name;
+    stats->object_size = pool->stride ? pool->stride : pool_stride(pool->size);
+    stats->capacity = pool->capacity;
+    stats->in_use = pool->taken - cached_objects(pool);
+    stats->high_water = pool->high_water;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,71 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define POOL_CACHE_LINE 64
+#define POOL_MAX_SLAB_OBJECTS 4096 // Growth past the reserve is in slabs of at most this many
+#define POOL_CACHE_BATCH 32        // Objects a thread cache takes from or gives back to the pool at once
+
+// A thread's private free list, so its allocations skip the pool's lock
+typedef struct {
+    void *free_list;
+    size_t count;          // Objects on free_list; read by pool_get_stats
+} __attribute__((aligned(POOL_CACHE_LINE))) pool_cache_t;
+
+// Fixed-size object pool. Objects are carved out of cache-line aligned
+// slabs and recycled through a free list, so steady churn never reaches
+// malloc. Object sizes are rounded up to a power of two (at most a cache
+// line, then to whole lines) so no object straddles a line. Slabs are only
+// returned to the system by pool_destroy.
+//
+// Threads that called pool_thread_cache allocate from and free to their own
+// cache, which trades POOL_CACHE_BATCH objects at a time with the shared
+// free list; other threads take the pool's lock for every object.
+typedef struct {
+    const char *name;      // For stats
+    size_t size;           // Requested object size
+    size_t stride;         // Rounded size each object occupies
+    void *free_list;       // Free objects, linked through their first word
+    void *slabs;           // Allocated slabs, linked through their first word
+    size_t capacity;       // Objects in all slabs
+    size_t taken;          // Objects off the shared free list: in use or in a cache
+    size_t high_water;     // Largest in-use count seen
+    pool_cache_t *caches;  // See pool_set_caches
+    size_t cache_count;
+    pthread_mutex_t lock;
+} pool_t;
+
+#define POOL_INITIALIZER(pool_name, object_size) \
+    { (pool_name), (object_size), 0, NULL, NULL, 0, 0, 0, NULL, 0, PTHREAD_MUTEX_INITIALIZER }
+
+// Occupancy snapshot
+typedef struct {
+    const char *name;
+    size_t object_size;    // Bytes per object including rounding
+    size_t capacity;
+    size_t in_use;
+    size_t high_water;     // Sampled when caches refill, so it can be off by a batch
+} pool_stats_t;
+
+// Make room for at least count objects up front; returns 0 or -1
+int pool_reserve(pool_t *pool, size_t count);
+// Give the pool count thread caches, numbered from 0; call before any
+// thread uses it. Returns 0 or -1.
+int pool_set_caches(pool_t *pool, size_t count);
+// Frees every slab and cache; only valid once no object is in use
+void pool_destroy(pool_t *pool);
+
+// From now on the calling thread uses cache id of every pool that has one
+// (-1 for none). Each cache must belong to one thread only.
+void pool_thread_cache(int id);
+
+// Returns an uninitialized object, or NULL when out of memory
+void* pool_alloc(pool_t *pool);
+void pool_free(pool_t *pool, void *object);
+
+void pool_get_stats(pool_t *pool, pool_stats_t *stats);
+
+#endif // POOL_H
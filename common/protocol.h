@@ -2,15 +2,21 @@
 #define PROTOCOL_H
 
 #include <stdint.h>
+#include <time.h>
+#include "id_set.h"
 
 #define MAX_USERNAME_LEN 32
 #define MAX_PASSWORD_LEN 64
 #define MAX_GROUP_NAME_LEN 32
 #define MAX_MESSAGE_LEN 1024
-#define MAX_GROUPS_PER_USER 10
-#define MAX_USERS_PER_GROUP 20
 #define MAX_CLIENTS 100
 
+// Wire framing: every frame is a fixed header followed by `length` payload bytes.
+// Only the used part of a payload is sent, never the whole message_t.
+#define PROTOCOL_VERSION 3
+#define FRAME_HEADER_LEN 12
+#define MAX_PAYLOAD_LEN (MAX_MESSAGE_LEN + 128) // Fits the largest payload: full-length text plus its fields
+
 // Message types
 typedef enum {
     MSG_LOGIN = 1,
@@ -24,14 +30,32 @@ typedef enum {
     MSG_LEAVE_GROUP = 9,
     MSG_LOGOUT = 10,
     MSG_ERROR = 11,
-    MSG_SUCCESS = 12
+    MSG_SUCCESS = 12,
+    MSG_HISTORY_REQUEST = 13,
+    MSG_HISTORY_RESPONSE = 14,
+    MSG_PING = 15,             // Either side; answered with a MSG_PONG carrying the same request id
+    MSG_PONG = 16
 } message_type_t;
 
-// Message structure
+// Frame header as sent on the wire (all fields in network byte order):
+//   version:u8 | type:u8 | flags:u16 | length:u32 | request_id:u32
+// A client numbers its requests; the server copies the id onto the response
+// (and onto the chat frames answering a history request). Frames the server
+// sends on its own, such as chat fan-out, carry 0.
+typedef struct {
+    uint8_t version;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t length;
+    uint32_t request_id;
+} frame_header_t;
+
+// Message structure (in-memory; `length` is the number of valid bytes in data)
 typedef struct {
     message_type_t type;
     uint32_t length;
-    char data[MAX_MESSAGE_LEN];
+    uint32_t request_id;
+    char data[MAX_PAYLOAD_LEN];
 } message_t;
 
 // Login/Register message
@@ -40,7 +64,8 @@ typedef struct {
     char password[MAX_PASSWORD_LEN];
 } auth_message_t;
 
-// Response message
+// Response to a login or registration. Like the other responses it travels
+// in the compact encoding of common/codec.h; this is its decoded form.
 typedef struct {
     int success;
     char message[MAX_MESSAGE_LEN];
@@ -52,28 +77,67 @@ typedef struct {
     char username[MAX_USERNAME_LEN];
 } group_message_t;
 
-// Chat message
+// Response to a join, create or leave (encoded by common/codec.h, like
+// response_message_t). It carries the group's ID, which is how chat
+// messages name the group.
+// After a login, the server also sends one (request_id 0, "Rejoined group")
+// for every group the user still belongs to, ahead of any missed messages.
 typedef struct {
+    int success;
+    uint32_t group_id; // 0 on failure
     char group_name[MAX_GROUP_NAME_LEN];
-    char username[MAX_USERNAME_LEN];
     char message[MAX_MESSAGE_LEN];
-    time_t timestamp;
+} group_response_t;
+
+// Chat message, decoded. On the wire it is the compact encoding in
+// common/codec.h; this is what chat_encode takes and chat_decode fills in.
+typedef struct {
+    uint32_t group_id; // From the group's group_response_t
+    uint64_t seq;      // Set by the server: position in the group's history, from 1
+    int64_t timestamp; // Unix seconds; set by the server
+    char username[MAX_USERNAME_LEN]; // Sender; set by the server
+    uint32_t length;   // Bytes of text, not counting the terminator
+    char message[MAX_MESSAGE_LEN];
 } chat_message_t;
 
-// User structure
+// History request: the group's stored messages with seq >= since_seq.
+// The server replies with a bounded batch of MSG_CHAT_MESSAGE frames,
+// oldest first, followed by one MSG_HISTORY_RESPONSE. Both travel in the
+// compact encoding of common/codec.h; these are their decoded forms.
 typedef struct {
-    char username[MAX_USERNAME_LEN];
+    char group_name[MAX_GROUP_NAME_LEN];
+    uint64_t since_seq;
+} history_request_t;
+
+typedef struct {
+    int success;       // 0 if the group is unknown or the user is not a member
+    uint32_t count;    // Messages in the batch
+    uint64_t next_seq; // Where the next request should start
+    uint32_t more;     // 1 if the batch was cut short and more history follows
+    char group_name[MAX_GROUP_NAME_LEN];
+} history_response_t;
+
+// User structure (server side). Names are interned: username points at the
+// shared copy in the user name table and groups are held as group IDs.
+typedef struct {
+    uint32_t id;
+    const char *username;
     int socket_fd;
     int is_online;
-    char groups[MAX_GROUPS_PER_USER][MAX_GROUP_NAME_LEN];
-    int group_count;
+    uint32_t shard;    // Reactor thread that owns socket_fd
+    uint32_t conn_id;  // Connection the user logged in on; see connection_t
+    id_set_t groups;
 } user_t;
 
-// Group structure
+// Group structure (server side). Membership sets grow with actual membership.
 typedef struct {
-    char name[MAX_GROUP_NAME_LEN];
-    char members[MAX_USERS_PER_GROUP][MAX_USERNAME_LEN];
-    int member_count;
+    uint32_t id;
+    const char *name;
+    id_set_t members;          // User IDs
+    user_t **online;           // Online members sorted by user ID, the fan-out targets
+    uint32_t online_count;
+    uint32_t online_capacity;
+    struct group_log *history;  // Stored messages; see server/history.h
 } group_t;
 
 #endif // PROTOCOL_H
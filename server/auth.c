@@ -1,214 +1,244 @@
 #include "auth.h"
+#include "network.h"
+#include "shard.h"
+#include "credentials.h"
+#include "password.h"
+#include "config.h"
+#include "metrics.h"
+#include "history.h"
+#include "../common/frame.h"
+#include "../common/codec.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <time.h>
 
-#define USERS_FILE "users.dat"
-#define MAX_LINE_LEN 256
+// Name tables: every user and group name is stored once and referred to by ID
+static intern_table_t *user_names = NULL;
+static intern_table_t *group_names = NULL;
 
-// Simple file-based user storage
-static int save_user_data(const char *username, const char *password) {
-    FILE *file = fopen(USERS_FILE, "a");
-    if (!file) return 0;
-    
-    fprintf(file, "%s:%s\n", username, password);
-    fclose(file);
-    return 1;
+int auth_init(const char *users_file) {
+    user_names = intern_table_create();
+    group_names = intern_table_create();
+    if (!user_names || !group_names) {
+        return -1;
+    }
+    return users_file ? credentials_open(users_file) : 0;
 }
 
-static int load_user_data(const char *username, char *password) {
-    FILE *file = fopen(USERS_FILE, "r");
-    if (!file) return 0;
-    
-    char line[MAX_LINE_LEN];
-    char stored_username[MAX_USERNAME_LEN];
-    char stored_password[MAX_PASSWORD_LEN];
-    
-    while (fgets(line, sizeof(line), file)) {
-        if (sscanf(line, "%[^:]:%s", stored_username, stored_password) == 2) {
-            if (strcmp(stored_username, username) == 0) {
-                strcpy(password, stored_password);
-                fclose(file);
-                return 1;
-            }
-        }
-    }
-    
-    fclose(file);
-    return 0;
+void auth_cleanup() {
+    credentials_close();
+    intern_table_destroy(user_names);
+    intern_table_destroy(group_names);
+    user_names = NULL;
+    group_names = NULL;
 }
 
 int authenticate_user(const char *username, const char *password) {
-    char stored_password[MAX_PASSWORD_LEN];
-    
-    if (load_user_data(username, stored_password)) {
-        return strcmp(password, stored_password) == 0;
-    }
-    return 0;
+    char record[PASSWORD_RECORD_LEN];
+    return credentials_lookup(username, record) && password_verify(password, record);
 }
 
 int register_user(const char *username, const char *password) {
-    // Check if user already exists
-    char stored_password[MAX_PASSWORD_LEN];
-    if (load_user_data(username, stored_password)) {
-        return 0; // User already exists
+    // Skip the hashing work for names that are obviously taken
+    char record[PASSWORD_RECORD_LEN];
+    if (credentials_lookup(username, record)) {
+        return 0;
+    }
+    if (password_hash(password, server_config.hash_iterations, record) < 0) {
+        return 0;
     }
     
-    return save_user_data(username, password);
+    // Still fails if the same name was registered while we were hashing
+    return credentials_add(username, record);
 }
 
+pool_t user_pool = POOL_INITIALIZER("users", sizeof(user_t));
+pool_t group_pool = POOL_INITIALIZER("groups", sizeof(group_t));
+
 user_t* create_user(const char *username, int socket_fd) {
-    user_t *user = malloc(sizeof(user_t));
+    uint32_t id = intern(user_names, username);
+    if (id == INVALID_ID) return NULL;
+    
+    user_t *user = pool_alloc(&user_pool);
     if (!user) return NULL;
     
-    strncpy(user->username, username, MAX_USERNAME_LEN - 1);
-    user->username[MAX_USERNAME_LEN - 1] = '\0';
+    user->id = id;
+    user->username = intern_name(user_names, id);
     user->socket_fd = socket_fd;
     user->is_online = 1;
-    user->group_count = 0;
-    
-    // Initialize groups array
-    for (int i = 0; i < MAX_GROUPS_PER_USER; i++) {
-        user->groups[i][0] = '\0';
-    }
+    user->shard = 0;
+    user->conn_id = 0;
+    id_set_init(&user->groups);
     
     return user;
 }
 
 void destroy_user(user_t *user) {
     if (user) {
-        free(user);
+        id_set_free(&user->groups);
+        pool_free(&user_pool, user);
     }
 }
 
-int add_user_to_group(user_t *user, const char *group_name) {
-    if (!user || !group_name || user->group_count >= MAX_GROUPS_PER_USER) {
-        return 0;
-    }
-    
-    // Check if user is already in the group
-    if (is_user_in_group(user, group_name)) {
+int add_user_to_group(user_t *user, uint32_t group_id) {
+    if (!user || group_id == INVALID_ID) {
         return 0;
     }
     
-    strncpy(user->groups[user->group_count], group_name, MAX_GROUP_NAME_LEN - 1);
-    user->groups[user->group_count][MAX_GROUP_NAME_LEN - 1] = '\0';
-    user->group_count++;
-    
-    return 1;
+    // Fails if the user is already in the group
+    return id_set_add(&user->groups, group_id) > 0;
 }
 
-int remove_user_from_group(user_t *user, const char *group_name) {
-    if (!user || !group_name) return 0;
+int remove_user_from_group(user_t *user, uint32_t group_id) {
+    if (!user) return 0;
     
-    for (int i = 0; i < user->group_count; i++) {
-        if (strcmp(user->groups[i], group_name) == 0) {
-            // Shift remaining groups
-            for (int j = i; j < user->group_count - 1; j++) {
-                strcpy(user->groups[j], user->groups[j + 1]);
-            }
-            user->group_count--;
-            return 1;
-        }
-    }
-    return 0;
+    return id_set_remove(&user->groups, group_id);
 }
 
-int is_user_in_group(user_t *user, const char *group_name) {
-    if (!user || !group_name) return 0;
+int is_user_in_group(user_t *user, uint32_t group_id) {
+    if (!user) return 0;
     
-    for (int i = 0; i < user->group_count; i++) {
-        if (strcmp(user->groups[i], group_name) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+    return id_set_contains(&user->groups, group_id);
 }
 
 group_t* create_group(const char *group_name) {
-    group_t *group = malloc(sizeof(group_t));
-    if (!group) return NULL;
+    uint32_t id = intern(group_names, group_name);
+    if (id == INVALID_ID) return NULL;
     
-    strncpy(group->name, group_name, MAX_GROUP_NAME_LEN - 1);
-    group->name[MAX_GROUP_NAME_LEN - 1] = '\0';
-    group->member_count = 0;
+    group_t *group = pool_alloc(&group_pool);
+    if (!group) return NULL;
     
-    // Initialize members array
-    for (int i = 0; i < MAX_USERS_PER_GROUP; i++) {
-        group->members[i][0] = '\0';
-    }
+    group->id = id;
+    group->name = intern_name(group_names, id);
+    id_set_init(&group->members);
+    group->online = NULL;
+    group->online_count = 0;
+    group->online_capacity = 0;
+    group->history = NULL;
     
     return group;
 }
 
 void destroy_group(group_t *group) {
     if (group) {
-        free(group);
+        id_set_free(&group->members);
+        free(group->online);
+        pool_free(&group_pool, group);
     }
 }
 
-int add_member_to_group(group_t *group, const char *username) {
-    if (!group || !username || group->member_count >= MAX_USERS_PER_GROUP) {
+int add_member_to_group(group_t *group, uint32_t user_id) {
+    if (!group || user_id == INVALID_ID) {
         return 0;
     }
     
-    // Check if user is already a member
-    for (int i = 0; i < group->member_count; i++) {
-        if (strcmp(group->members[i], username) == 0) {
-            return 0;
+    // Fails if the user is already a member
+    return id_set_add(&group->members, user_id) > 0;
+}
+
+int remove_member_from_group(group_t *group, uint32_t user_id) {
+    if (!group) return 0;
+    
+    return id_set_remove(&group->members, user_id);
+}
+
+// Index of the first online member whose ID is >= user_id
+static uint32_t online_lower_bound(const group_t *group, uint32_t user_id) {
+    uint32_t low = 0;
+    uint32_t high = group->online_count;
+    
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (group->online[mid]->id < user_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
+    return low;
+}
+
+int add_online_member(group_t *group, user_t *user) {
+    if (!group || !user) return 0;
+    
+    uint32_t pos = online_lower_bound(group, user->id);
+    if (pos < group->online_count && group->online[pos] == user) {
+        return 0;
+    }
     
-    strncpy(group->members[group->member_count], username, MAX_USERNAME_LEN - 1);
-    group->members[group->member_count][MAX_USERNAME_LEN - 1] = '\0';
-    group->member_count++;
+    if (group->online_count == group->online_capacity) {
+        uint32_t capacity = group->online_capacity ? group->online_capacity * 2 : 4;
+        user_t **grown = realloc(group->online, capacity * sizeof(user_t*));
+        if (!grown) return 0;
+        
+        group->online = grown;
+        group->online_capacity = capacity;
+    }
     
+    memmove(&group->online[pos + 1], &group->online[pos],
+            (group->online_count - pos) * sizeof(user_t*));
+    group->online[pos] = user;
+    group->online_count++;
     return 1;
 }
 
-int remove_member_from_group(group_t *group, const char *username) {
-    if (!group || !username) return 0;
+void remove_online_member(group_t *group, user_t *user) {
+    if (!group || !user) return;
     
-    for (int i = 0; i < group->member_count; i++) {
-        if (strcmp(group->members[i], username) == 0) {
-            // Shift remaining members
-            for (int j = i; j < group->member_count - 1; j++) {
-                strcpy(group->members[j], group->members[j + 1]);
-            }
-            group->member_count--;
-            return 1;
-        }
+    uint32_t pos = online_lower_bound(group, user->id);
+    if (pos >= group->online_count || group->online[pos] != user) {
+        return;
+    }
+    
+    memmove(&group->online[pos], &group->online[pos + 1],
+            (group->online_count - pos - 1) * sizeof(user_t*));
+    group->online_count--;
+    
+    if (group->online_count == 0) {
+        free(group->online);
+        group->online = NULL;
+        group->online_capacity = 0;
     }
-    return 0;
-}
-
-void broadcast_message_to_group(const char *group_name, const char *message, const char *sender, list_t *users) {
-    if (!group_name || !message || !sender || !users) return;
-    
-    chat_message_t chat_msg;
-    strncpy(chat_msg.group_name, group_name, MAX_GROUP_NAME_LEN - 1);
-    strncpy(chat_msg.username, sender, MAX_USERNAME_LEN - 1);
-    strncpy(chat_msg.message, message, MAX_MESSAGE_LEN - 1);
-    chat_msg.timestamp = time(NULL);
-    
-    // Create the message to send
-    message_t msg;
-    msg.type = MSG_CHAT_MESSAGE;
-    msg.length = sizeof(chat_message_t);
-    memcpy(msg.data, &chat_msg, sizeof(chat_message_t));
-    
-    // Send to all online users in the group
-    list_node_t *current = users->head;
-    while (current) {
-        user_t *user = (user_t*)current->data;
-        if (user->is_online && is_user_in_group(user, group_name)) {
-            // Send message to user
-            send(user->socket_fd, &msg, sizeof(message_t), 0);
+}
+
+void broadcast_message_to_group(group_t *group, const char *message, uint32_t length, const char *sender) {
+    if (!group || !message || !sender) return;
+    
+    uint64_t started = metrics_now();
+    
+    // Stored messages are numbered; the group's log stays locked through the
+    // fan-out so every member sees them in sequence order
+    uint64_t seq = group->history ? history_lock(group->history) : 0;
+    
+    // Encode once (see common/codec.h), straight into a shared frame; every
+    // recipient's queue references the same bytes
+    size_t payload_len = chat_encoded_len(group->id, seq, sender, length);
+    shared_frame_t *frame = shared_frame_alloc(FRAME_HEADER_LEN + payload_len);
+    if (frame) {
+        uint8_t *payload = frame->data + FRAME_HEADER_LEN;
+        frame_encode_header(MSG_CHAT_MESSAGE, 0, payload_len, frame->data);
+        size_t prefix_len = chat_encode_prefix(group->id, seq, payload);
+        chat_encode_body(time(NULL), sender, message, length, payload + prefix_len);
+        if (group->history) {
+            // The record is the body; group ID and seq are put back on replay
+            history_append(group->history, payload + prefix_len, payload_len - prefix_len);
         }
-        current = current->next;
+        
+        // Only the group's online members are visited; members owned by other
+        // reactor threads get one posted reference per thread
+        shard_fanout_begin(frame);
+        for (uint32_t i = 0; i < group->online_count; i++) {
+            shard_fanout_add(group->online[i]);
+        }
+        shard_fanout_end();
+        shared_frame_release(frame);
+    }
+    if (group->history) {
+        history_unlock(group->history);
     }
+    
+    metrics_count(METRIC_FANOUT_DELIVERIES, group->online_count);
+    metrics_observe(METRIC_FANOUT_SECONDS, metrics_now() - started);
 }
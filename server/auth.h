@@ -3,25 +3,38 @@
 
 #include "../common/protocol.h"
 #include "../common/list.h"
+#include "../common/intern.h"
+#include "../common/pool.h"
 
-// User authentication functions
+// Pools for the user and group records
+extern pool_t user_pool;
+extern pool_t group_pool;
+
+// Module setup: creates the user and group name tables and loads the
+// credential store from users_file (NULL for name tables only)
+int auth_init(const char *users_file);
+void auth_cleanup();
+
+// User authentication functions. Both do the slow password hashing and
+// are run by the auth workers, not on a reactor thread.
 int authenticate_user(const char *username, const char *password);
 int register_user(const char *username, const char *password);
-int add_user_to_group(user_t *user, const char *group_name);
-int remove_user_from_group(user_t *user, const char *group_name);
-int is_user_in_group(user_t *user, const char *group_name);
-void broadcast_message_to_group(const char *group_name, const char *message, const char *sender, list_t *users);
+int add_user_to_group(user_t *user, uint32_t group_id);
+int remove_user_from_group(user_t *user, uint32_t group_id);
+int is_user_in_group(user_t *user, uint32_t group_id);
+// Sends length bytes of text from sender to the group's online members
+void broadcast_message_to_group(group_t *group, const char *message, uint32_t length, const char *sender);
 
-// User management functions
+// User management functions; destroy_user is in list.h
 user_t* create_user(const char *username, int socket_fd);
-void destroy_user(user_t *user);
-int save_user_data(const char *username, const char *password);
-int load_user_data(const char *username, char *password);
 
-// Group management functions
+// Group management functions; destroy_group is in list.h
 group_t* create_group(const char *group_name);
-void destroy_group(group_t *group);
-int add_member_to_group(group_t *group, const char *username);
-int remove_member_from_group(group_t *group, const char *username);
+int add_member_to_group(group_t *group, uint32_t user_id);
+int remove_member_from_group(group_t *group, uint32_t user_id);
+
+// Online member index (what broadcast iterates)
+int add_online_member(group_t *group, user_t *user);
+void remove_online_member(group_t *group, user_t *user);
 
 #endif // SERVER_AUTH_H
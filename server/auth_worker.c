@@ -0,0 +1,118 @@
+#include "auth_worker.h"
+#include "auth.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static auth_job_t *queue_head = NULL;
+static auth_job_t *queue_tail = NULL;
+static int queue_length = 0;
+static int stopping = 0;
+
+static pthread_t *workers = NULL;
+static int worker_count = 0;
+
+static auth_job_t* next_job() {
+    pthread_mutex_lock(&queue_lock);
+    while (!queue_head && !stopping) {
+        pthread_cond_wait(&queue_ready, &queue_lock);
+    }
+
+    auth_job_t *job = NULL;
+    if (!stopping) {
+        job = queue_head;
+        queue_head = job->next;
+        if (!queue_head) {
+            queue_tail = NULL;
+        }
+        queue_length--;
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return job;
+}
+
+static void* worker_run(void *arg) {
+    (void)arg;
+
+    auth_job_t *job;
+    while ((job = next_job())) {
+        if (job->type == AUTH_JOB_LOGIN) {
+            job->success = authenticate_user(job->username, job->password);
+        } else {
+            job->success = register_user(job->username, job->password);
+        }
+        // The result is all the reactor needs; don't keep the password around
+        memset(job->password, 0, sizeof(job->password));
+
+        shard_post_task(job->shard, &job->task);
+    }
+    return NULL;
+}
+
+int auth_workers_start(int count) {
+    workers = calloc(count, sizeof(pthread_t));
+    if (!workers) return -1;
+
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&workers[i], NULL, worker_run, NULL) != 0) {
+            LOG_ERROR("pthread_create failed: %m");
+            return -1;
+        }
+        worker_count++;
+    }
+    return 0;
+}
+
+void auth_workers_stop() {
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+
+    while (queue_head) {
+        auth_job_t *job = queue_head;
+        queue_head = job->next;
+        free(job);
+    }
+    queue_tail = NULL;
+    queue_length = 0;
+}
+
+int auth_queue_length() {
+    pthread_mutex_lock(&queue_lock);
+    int length = queue_length;
+    pthread_mutex_unlock(&queue_lock);
+    return length;
+}
+
+int auth_submit(auth_job_t *job) {
+    pthread_mutex_lock(&queue_lock);
+    if (stopping || !workers || queue_length >= AUTH_QUEUE_CAPACITY) {
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+
+    job->next = NULL;
+    if (queue_tail) {
+        queue_tail->next = job;
+    } else {
+        queue_head = job;
+    }
+    queue_tail = job;
+    queue_length++;
+
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef SERVER_AUTH_WORKER_H
+#define SERVER_AUTH_WORKER_H
+
+#include <stdint.h>
+#include "shard.h"
+#include "../common/protocol.h"
+#include "../common/list.h"
+
+#define DEFAULT_AUTH_THREADS 2
+#define AUTH_QUEUE_CAPACITY 1024
+
+typedef enum {
+    AUTH_JOB_LOGIN,
+    AUTH_JOB_REGISTER
+} auth_job_type_t;
+
+// A login or registration whose password work runs off the reactor. The
+// submitting shard fills in everything but success; once a worker has
+// run the job it is posted back to that shard as a task.
+typedef struct auth_job {
+    shard_task_t task;          // Must be first; task.run handles the result
+    auth_job_type_t type;
+    uint32_t shard;
+    int client_socket;
+    uint32_t conn_id;           // Result is dropped if the connection went away
+    uint32_t request_id;        // Copied onto the response
+    list_t *users;
+    list_t *groups;
+    char username[MAX_USERNAME_LEN];
+    char password[MAX_PASSWORD_LEN];
+    int success;
+    uint64_t submitted_ns;      // For the auth latency histogram
+    struct auth_job *next;      // Queue link
+} auth_job_t;
+
+// Bounded pool of hashing threads
+int auth_workers_start(int count);
+// Joins the workers; jobs still queued are freed without running
+void auth_workers_stop();
+
+// Returns 0 if queued, -1 if the queue is full or the pool is stopped
+// (the caller still owns the job)
+int auth_submit(auth_job_t *job);
+// Jobs waiting for a worker
+int auth_queue_length();
+
+#endif // SERVER_AUTH_WORKER_H
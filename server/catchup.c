@@ -0,0 +1,244 @@
+#include "catchup.h"
+#include "history.h"
+#include "auth.h"
+#include "network.h"
+#include "logger.h"
+#include "config.h"
+#include "../common/frame.h"
+#include "../common/codec.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Most bytes one batch adds to a connection's queue: its payloads plus a
+// frame header and group ID/seq prefix per message
+#define CATCHUP_BATCH_QUEUED (HISTORY_BATCH_BYTES + \
+                              HISTORY_BATCH_MESSAGES * (FRAME_HEADER_LEN + CHAT_PREFIX_MAX_LEN))
+
+// One group's missed messages: [next, end)
+typedef struct {
+    group_log_t *log;
+    uint32_t group_id;
+    uint64_t next;
+    uint64_t end;
+} catchup_range_t;
+
+// Hangs off the connection and is freed with it
+typedef struct catchup {
+    uint32_t current;     // Range being sent
+    uint32_t count;
+    catchup_range_t ranges[];
+} catchup_t;
+
+// Connections of this shard with backlog left
+typedef struct {
+    int fd;
+    uint32_t conn_id;     // Guards against the fd having been reused
+} catchup_target_t;
+
+static __thread catchup_target_t *pending = NULL;
+static __thread uint32_t pending_count = 0;
+static __thread uint32_t pending_capacity = 0;
+
+// An offline user's cursors, one per group with history
+typedef struct {
+    delivery_cursor_t *cursors;
+    uint32_t count;
+} saved_cursors_t;
+
+// Indexed by user ID, which is dense; guarded by the registry lock
+static saved_cursors_t *saved = NULL;
+static uint32_t saved_capacity = 0;
+
+// The user's slot, grown to fit; NULL when out of memory
+static saved_cursors_t* saved_slot(uint32_t user_id) {
+    if (user_id >= saved_capacity) {
+        uint32_t capacity = saved_capacity ? saved_capacity : 64;
+        while (capacity <= user_id) {
+            capacity *= 2;
+        }
+        saved_cursors_t *grown = realloc(saved, capacity * sizeof(saved_cursors_t));
+        if (!grown) return NULL;
+
+        memset(grown + saved_capacity, 0, (capacity - saved_capacity) * sizeof(saved_cursors_t));
+        saved = grown;
+        saved_capacity = capacity;
+    }
+    return &saved[user_id];
+}
+
+static void drop_cursors(saved_cursors_t *slot) {
+    free(slot->cursors);
+    slot->cursors = NULL;
+    slot->count = 0;
+}
+
+// Where an unfinished backlog for the group stopped, or 0
+static uint64_t unsent_from(const catchup_t *catchup, uint32_t group_id) {
+    if (!catchup) return 0;
+
+    for (uint32_t i = catchup->current; i < catchup->count; i++) {
+        if (catchup->ranges[i].group_id == group_id) {
+            return catchup->ranges[i].next;
+        }
+    }
+    return 0;
+}
+
+void catchup_save_cursors(user_t *user, list_t *groups, const connection_t *conn) {
+    saved_cursors_t *slot = saved_slot(user->id);
+    if (!slot) return; // The user just misses the backlog
+
+    drop_cursors(slot);
+    if (user->groups.count == 0) return;
+
+    slot->cursors = malloc(user->groups.count * sizeof(delivery_cursor_t));
+    if (!slot->cursors) return;
+
+    for (uint32_t i = 0; i < user->groups.count; i++) {
+        group_t *group = group_list_find_by_id(groups, user->groups.ids[i]);
+        if (!group || !group->history) continue;
+
+        delivery_cursor_t *cursor = &slot->cursors[slot->count++];
+        cursor->group_id = group->id;
+        cursor->seq = unsent_from(conn ? conn->catchup : NULL, group->id);
+        if (cursor->seq == 0) {
+            cursor->seq = history_next_seq(group->history);
+        }
+    }
+}
+
+static int add_pending(connection_t *conn) {
+    if (pending_count == pending_capacity) {
+        uint32_t capacity = pending_capacity ? pending_capacity * 2 : 16;
+        catchup_target_t *grown = realloc(pending, capacity * sizeof(catchup_target_t));
+        if (!grown) return -1;
+        pending = grown;
+        pending_capacity = capacity;
+    }
+    pending[pending_count].fd = conn->fd;
+    pending[pending_count].conn_id = conn->id;
+    pending_count++;
+    return 0;
+}
+
+void catchup_start(user_t *user, list_t *groups, connection_t *conn) {
+    if (user->id >= saved_capacity) return;
+
+    saved_cursors_t *slot = &saved[user->id];
+    catchup_t *catchup = NULL;
+    if (slot->count > 0) {
+        catchup = malloc(sizeof(catchup_t) + slot->count * sizeof(catchup_range_t));
+    }
+
+    if (catchup) {
+        catchup->current = 0;
+        catchup->count = 0;
+        for (uint32_t i = 0; i < slot->count; i++) {
+            delivery_cursor_t *cursor = &slot->cursors[i];
+            group_t *group = group_list_find_by_id(groups, cursor->group_id);
+            if (!group || !group->history || !is_user_in_group(user, group->id)) continue;
+
+            // Messages from here on reach the user live, so the range ends here
+            uint64_t end = history_next_seq(group->history);
+            if (end <= cursor->seq) continue;
+
+            catchup_range_t *range = &catchup->ranges[catchup->count++];
+            range->log = group->history;
+            range->group_id = group->id;
+            range->next = cursor->seq;
+            range->end = end;
+        }
+
+        if (catchup->count > 0 && add_pending(conn) == 0) {
+            free(conn->catchup);
+            conn->catchup = catchup;
+            LOG_DEBUG("User %s catching up on %u groups", user->username, catchup->count);
+        } else {
+            free(catchup);
+        }
+    }
+
+    drop_cursors(slot);
+}
+
+void catchup_cleanup() {
+    for (uint32_t i = 0; i < saved_capacity; i++) {
+        free(saved[i].cursors);
+    }
+    free(saved);
+    saved = NULL;
+    saved_capacity = 0;
+}
+
+// A frame that could not be queued stops the batch; the range resumes from
+// it on a later iteration (or, if the connection is closing, from the cursor
+// saved at disconnect)
+static int send_backlog_message(uint64_t seq, const uint8_t *payload, uint32_t len, void *arg) {
+    connection_t *conn = (connection_t*)arg;
+    shared_frame_t *frame = chat_replay_frame(0, conn->catchup->ranges[conn->catchup->current].group_id,
+                                              seq, payload, len);
+    if (!frame) return -1;
+    int result = connection_send_shared(conn, frame);
+    shared_frame_release(frame);
+    return result;
+}
+
+// Returns 1 once the connection's backlog is all sent
+static int send_batch(connection_t *conn) {
+    catchup_t *catchup = conn->catchup;
+    catchup_range_t *range = &catchup->ranges[catchup->current];
+    int more;
+    range->next = history_read(range->log, range->next, range->end,
+                               send_backlog_message, conn, &more);
+    if (!more) {
+        catchup->current++; // The next group waits for the next batch
+    }
+    return catchup->current == catchup->count;
+}
+
+// A batch only starts if all of it fits under the send high-water mark, so
+// the slow-consumer policy never drops or disconnects over backlog
+static int has_room(const connection_t *conn) {
+    return conn->out_bytes + CATCHUP_BATCH_QUEUED <= server_config.send_high_water;
+}
+
+// The connection for a target, or NULL if it closed or finished
+static connection_t* target_connection(catchup_target_t *target) {
+    connection_t *conn = connection_lookup(target->fd);
+    if (!conn || conn->id != target->conn_id || conn->closing || !conn->catchup) {
+        return NULL;
+    }
+    return conn;
+}
+
+void catchup_run() {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < pending_count; i++) {
+        connection_t *conn = target_connection(&pending[i]);
+        if (!conn) continue;
+
+        if (has_room(conn) && send_batch(conn)) {
+            free(conn->catchup);
+            conn->catchup = NULL;
+            continue;
+        }
+        pending[kept++] = pending[i];
+    }
+    pending_count = kept;
+
+    if (pending_count == 0 && pending) {
+        free(pending);
+        pending = NULL;
+        pending_capacity = 0;
+    }
+}
+
+int catchup_ready() {
+    for (uint32_t i = 0; i < pending_count; i++) {
+        connection_t *conn = target_connection(&pending[i]);
+        if (conn && has_room(conn)) {
+            return 1;
+        }
+    }
+    return 0;
+}
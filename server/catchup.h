@@ -0,0 +1,42 @@
+#ifndef SERVER_CATCHUP_H
+#define SERVER_CATCHUP_H
+
+#include <stdint.h>
+#include "../common/protocol.h"
+#include "../common/list.h"
+#include "connection.h"
+
+// Offline delivery. When a user disconnects, each of their groups' history
+// position is saved as a delivery cursor; when they log back in, everything
+// stored since is streamed to them from the group logs. The backlog goes out
+// one bounded batch per loop iteration, and only when the whole batch fits
+// under the connection's send high-water mark, so live traffic interleaves
+// with it and a long absence never trips the slow-consumer policy.
+
+// Where a group's history stood when the user went offline. Kept by user ID
+// until the next login.
+typedef struct {
+    uint32_t group_id;
+    uint64_t seq;         // First sequence number the user has not seen
+} delivery_cursor_t;
+
+// Save the user's cursors as they go offline, from the connection they are
+// leaving: a group whose backlog was not all sent keeps its cursor where
+// sending stopped. Call under the registry write lock.
+void catchup_save_cursors(user_t *user, list_t *groups, const connection_t *conn);
+// Queue everything the user missed since their cursors on the connection they
+// just logged in on, then drop the cursors. Call under the registry write lock
+// on the connection's shard.
+void catchup_start(user_t *user, list_t *groups, connection_t *conn);
+
+// Send one batch to every connection of this shard with backlog and room
+// in its queue. Call once per loop iteration, before the flush.
+void catchup_run();
+// After the flush: whether a connection could take another batch right away,
+// in which case the loop should not block
+int catchup_ready();
+
+// Free every saved cursor; call after every thread has stopped
+void catchup_cleanup();
+
+#endif // SERVER_CATCHUP_H
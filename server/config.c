@@ -0,0 +1,200 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "shard.h"
+#include "auth_worker.h"
+#include "password.h"
+#include "history.h"
+
+server_config_t server_config = {
+    NULL,
+    0,
+    DEFAULT_SEND_HIGH_WATER,
+    SLOW_CONSUMER_DROP,
+    0,
+    DEFAULT_AUTH_THREADS,
+    DEFAULT_HASH_ITERATIONS,
+    0,
+    LOG_INFO,
+    DEFAULT_POOL_SIZE,
+    DEFAULT_HISTORY_DIR,
+    DEFAULT_IDLE_TIMEOUT,
+    DEFAULT_LOGIN_TIMEOUT,
+    DEFAULT_PING_INTERVAL
+};
+
+void print_server_usage(const char *program) {
+    printf("Usage: %s <server_ip> <port_number> [options]\n", program);
+    printf("Example: %s 0.0.0.0 8080\n", program);
+    printf("Options:\n");
+    printf("  --send-hwm <bytes>             Outbound queue limit per client (default %d)\n",
+           DEFAULT_SEND_HIGH_WATER);
+    printf("  --slow-consumer <drop|disconnect>\n");
+    printf("                                 Action when a client reaches the limit (default drop)\n");
+    printf("  --threads <count>              Reactor threads (default one per CPU, max %d)\n",
+           MAX_SHARDS);
+    printf("  --auth-threads <count>         Password hashing threads (default %d)\n",
+           DEFAULT_AUTH_THREADS);
+    printf("  --hash-iterations <count>      PBKDF2 iterations for new passwords (default %d)\n",
+           DEFAULT_HASH_ITERATIONS);
+    printf("  --admin-port <port>            Serve Prometheus metrics on 127.0.0.1:<port> (default off)\n");
+    printf("  --log-level <debug|info|warn|error>\n");
+    printf("                                 Minimum level written to stdout (default info)\n");
+    printf("  --pool-size <objects>          Users and groups to preallocate memory for (default %d)\n",
+           DEFAULT_POOL_SIZE);
+    printf("  --history-dir <path>           Directory for group message history (default %s)\n",
+           DEFAULT_HISTORY_DIR);
+    printf("  --idle-timeout <seconds>       Drop clients silent for this long, 0 for never (default %d)\n",
+           DEFAULT_IDLE_TIMEOUT);
+    printf("  --login-timeout <seconds>      Time a new connection gets to log in, 0 for unlimited (default %d)\n",
+           DEFAULT_LOGIN_TIMEOUT);
+    printf("  --ping-interval <seconds>      Ping clients silent for this long, 0 to disable (default %d)\n",
+           DEFAULT_PING_INTERVAL);
+}
+
+int parse_server_config(int argc, char *argv[], server_config_t *config) {
+    static const struct option options[] = {
+        { "send-hwm", required_argument, NULL, 'w' },
+        { "slow-consumer", required_argument, NULL, 's' },
+        { "threads", required_argument, NULL, 't' },
+        { "auth-threads", required_argument, NULL, 'a' },
+        { "hash-iterations", required_argument, NULL, 'i' },
+        { "admin-port", required_argument, NULL, 'm' },
+        { "log-level", required_argument, NULL, 'l' },
+        { "pool-size", required_argument, NULL, 'p' },
+        { "history-dir", required_argument, NULL, 'h' },
+        { "idle-timeout", required_argument, NULL, 'o' },
+        { "login-timeout", required_argument, NULL, 'g' },
+        { "ping-interval", required_argument, NULL, 'n' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+            case 'w': {
+                long value = atol(optarg);
+                if (value <= 0) {
+                    printf("Invalid --send-hwm value: %s\n", optarg);
+                    return -1;
+                }
+                // Room for a whole catch-up batch on top of live traffic
+                if (value < 2 * HISTORY_BATCH_BYTES) {
+                    printf("--send-hwm must be at least %d\n", 2 * HISTORY_BATCH_BYTES);
+                    return -1;
+                }
+                config->send_high_water = (size_t)value;
+                break;
+            }
+            case 's':
+                if (strcmp(optarg, "drop") == 0) {
+                    config->slow_consumer = SLOW_CONSUMER_DROP;
+                } else if (strcmp(optarg, "disconnect") == 0) {
+                    config->slow_consumer = SLOW_CONSUMER_DISCONNECT;
+                } else {
+                    printf("Invalid --slow-consumer value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 't':
+                config->threads = atoi(optarg);
+                if (config->threads <= 0 || config->threads > MAX_SHARDS) {
+                    printf("Invalid --threads value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'a':
+                config->auth_threads = atoi(optarg);
+                if (config->auth_threads <= 0) {
+                    printf("Invalid --auth-threads value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'i': {
+                long value = atol(optarg);
+                if (value <= 0) {
+                    printf("Invalid --hash-iterations value: %s\n", optarg);
+                    return -1;
+                }
+                config->hash_iterations = (unsigned)value;
+                break;
+            }
+            case 'm':
+                config->admin_port = atoi(optarg);
+                if (config->admin_port <= 0 || config->admin_port > 65535) {
+                    printf("Invalid --admin-port value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'l': {
+                int level = log_parse_level(optarg);
+                if (level < 0) {
+                    printf("Invalid --log-level value: %s\n", optarg);
+                    return -1;
+                }
+                config->log_level = (log_level_t)level;
+                break;
+            }
+            case 'p':
+                config->pool_size = atoi(optarg);
+                if (config->pool_size <= 0) {
+                    printf("Invalid --pool-size value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'h':
+                config->history_dir = optarg;
+                break;
+            case 'o':
+                config->idle_timeout = atoi(optarg);
+                if (config->idle_timeout < 0 || strspn(optarg, "0123456789") != strlen(optarg)) {
+                    printf("Invalid --idle-timeout value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'g':
+                config->login_timeout = atoi(optarg);
+                if (config->login_timeout < 0 || strspn(optarg, "0123456789") != strlen(optarg)) {
+                    printf("Invalid --login-timeout value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'n':
+                config->ping_interval = atoi(optarg);
+                if (config->ping_interval < 0 || strspn(optarg, "0123456789") != strlen(optarg)) {
+                    printf("Invalid --ping-interval value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    // GNU getopt moves the positional arguments to the end
+    if (argc - optind != 2) {
+        return -1;
+    }
+
+    config->ip = argv[optind];
+    config->port = atoi(argv[optind + 1]);
+    if (config->port <= 0 || config->port > 65535) {
+        printf("Invalid port number. Must be between 1 and 65535.\n");
+        return -1;
+    }
+
+    // A client that answers pings is never idle long enough to be dropped
+    if (config->idle_timeout && config->ping_interval >= config->idle_timeout) {
+        printf("--ping-interval must be shorter than --idle-timeout\n");
+        return -1;
+    }
+
+    if (config->threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config->threads = cpus < 1 ? 1 : (cpus > MAX_SHARDS ? MAX_SHARDS : (int)cpus);
+    }
+    return 0;
+}
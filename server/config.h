@@ -0,0 +1,42 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <stddef.h>
+#include "logger.h"
+
+// What to do with a client whose outbound queue reaches the high-water mark
+typedef enum {
+    SLOW_CONSUMER_DROP = 0,      // Discard new frames until the queue drains
+    SLOW_CONSUMER_DISCONNECT = 1 // Close the connection
+} slow_consumer_policy_t;
+
+#define DEFAULT_SEND_HIGH_WATER (256 * 1024)
+#define DEFAULT_POOL_SIZE 1024
+#define DEFAULT_IDLE_TIMEOUT 90  // Seconds
+#define DEFAULT_LOGIN_TIMEOUT 10
+#define DEFAULT_PING_INTERVAL 30
+
+typedef struct {
+    const char *ip;
+    int port;
+    size_t send_high_water;               // Max queued outbound bytes per connection
+    slow_consumer_policy_t slow_consumer;
+    int threads;                          // Reactor threads; defaults to one per online CPU
+    int auth_threads;                     // Password hashing workers
+    unsigned hash_iterations;             // PBKDF2 iterations for new registrations
+    int admin_port;                       // Local metrics endpoint; 0 disables it
+    log_level_t log_level;                // Lines below this level are discarded
+    int pool_size;                        // Users and groups to preallocate room for
+    const char *history_dir;              // Where group message history is kept
+    int idle_timeout;                     // Seconds without input before a client is dropped; 0 disables
+    int login_timeout;                    // Seconds a new connection gets to log in; 0 disables
+    int ping_interval;                    // Seconds of silence before the server pings; 0 disables
+} server_config_t;
+
+extern server_config_t server_config;
+
+// Parse "<server_ip> <port_number> [options]"; returns 0 on success, -1 on bad usage
+int parse_server_config(int argc, char *argv[], server_config_t *config);
+void print_server_usage(const char *program);
+
+#endif // SERVER_CONFIG_H
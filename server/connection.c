@@ -0,0 +1,374 @@
+#include "connection.h"
+#include "config.h"
+#include "metrics.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Each reactor thread owns its connections: the table and the close list
+// are per thread, and a connection is only ever touched by its owner
+static __thread connection_t **table = NULL;
+static __thread int table_capacity = 0;
+static __thread connection_t *closing_head = NULL;
+static __thread connection_t *flush_head = NULL;
+
+#define FLUSH_MAX_IOV 64 // Frames per writev; a longer queue takes more calls
+#define AUTH_RECHECK_MS 1000 // Login deadline passed with the password still being checked
+
+// Connection IDs tell a live connection apart from an earlier one that used the same fd
+static uint32_t next_connection_id = 1;
+
+int connection_table_init(int capacity) {
+    table = calloc(capacity, sizeof(connection_t*));
+    if (!table) return -1;
+
+    table_capacity = capacity;
+    return 0;
+}
+
+void connection_table_destroy() {
+    if (!table) return;
+
+    for (int fd = 0; fd < table_capacity; fd++) {
+        if (table[fd]) {
+            connection_destroy(table[fd]);
+        }
+    }
+    free(table);
+    table = NULL;
+    table_capacity = 0;
+    closing_head = NULL;
+    flush_head = NULL;
+}
+
+static int connection_table_grow(int fd) {
+    int capacity = table_capacity ? table_capacity : 64;
+    while (capacity <= fd) {
+        capacity *= 2;
+    }
+
+    connection_t **grown = realloc(table, capacity * sizeof(connection_t*));
+    if (!grown) return -1;
+
+    memset(grown + table_capacity, 0, (capacity - table_capacity) * sizeof(connection_t*));
+    table = grown;
+    table_capacity = capacity;
+    return 0;
+}
+
+connection_t* connection_lookup(int fd) {
+    if (fd < 0 || fd >= table_capacity) return NULL;
+    return table[fd];
+}
+
+static uint64_t earliest(uint64_t current, uint64_t candidate) {
+    return candidate < current ? candidate : current;
+}
+
+// Liveness check. It runs at the earliest time anything can be due and
+// works out from the connection's timestamps what is; input in between
+// only moved last_active, so a busy connection costs one check per period.
+static void connection_check(wheel_timer_t *timer) {
+    connection_t *conn = (connection_t*)((char*)timer - offsetof(connection_t, timer));
+    if (conn->closing) return;
+
+    uint64_t now = timer_now();
+    uint64_t next = UINT64_MAX;
+
+    if (conn->state == CONN_PRE_AUTH && server_config.login_timeout) {
+        if (now < conn->login_deadline) {
+            next = conn->login_deadline;
+        } else if (conn->auth_pending) {
+            // The login arrived in time; let the workers finish with it
+            next = now + AUTH_RECHECK_MS;
+        } else {
+            LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "Closing socket %d: no login within %ds",
+                             conn->fd, server_config.login_timeout);
+            metrics_count(METRIC_TIMEOUT_DISCONNECTS, 1);
+            connection_schedule_close(conn);
+            return;
+        }
+    }
+
+    if (server_config.idle_timeout) {
+        uint64_t idle_deadline = conn->last_active + server_config.idle_timeout * 1000ull;
+        if (now >= idle_deadline) {
+            LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "Closing socket %d: idle for %ds",
+                             conn->fd, server_config.idle_timeout);
+            metrics_count(METRIC_TIMEOUT_DISCONNECTS, 1);
+            connection_schedule_close(conn);
+            return;
+        }
+        next = earliest(next, idle_deadline);
+    }
+
+    if (server_config.ping_interval && !conn->ping_sent) {
+        uint64_t ping_due = conn->last_active + server_config.ping_interval * 1000ull;
+        if (now >= ping_due) {
+            uint8_t frame[FRAME_HEADER_LEN];
+            frame_encode_header(MSG_PING, 0, 0, frame);
+            connection_send(conn, frame, sizeof(frame));
+            conn->ping_sent = now;
+            // Answered or not, look again one interval on
+            next = earliest(next, now + server_config.ping_interval * 1000ull);
+        } else {
+            next = earliest(next, ping_due);
+        }
+    }
+
+    if (next != UINT64_MAX) {
+        timer_schedule(&conn->timer, next - now);
+    }
+}
+
+connection_t* connection_create(int fd) {
+    if (fd >= table_capacity && connection_table_grow(fd) < 0) {
+        return NULL;
+    }
+
+    connection_t *conn = calloc(1, sizeof(connection_t));
+    if (!conn) return NULL;
+
+    conn->fd = fd;
+    conn->id = __atomic_fetch_add(&next_connection_id, 1, __ATOMIC_RELAXED);
+    conn->state = CONN_PRE_AUTH;
+    metrics_gauge_add(METRIC_PRE_AUTH_CONNECTIONS, 1);
+    table[fd] = conn;
+
+    conn->last_active = timer_now();
+    conn->login_deadline = conn->last_active + server_config.login_timeout * 1000ull;
+    conn->timer.fire = connection_check;
+    connection_check(&conn->timer);
+    return conn;
+}
+
+void connection_set_state(connection_t *conn, connection_state_t state) {
+    if (conn->state == state) return;
+
+    metrics_gauge_add(METRIC_PRE_AUTH_CONNECTIONS, state == CONN_PRE_AUTH ? 1 : -1);
+    conn->state = state;
+}
+
+shared_frame_t* shared_frame_alloc(size_t len) {
+    shared_frame_t *frame = malloc(sizeof(shared_frame_t) + len);
+    if (!frame) return NULL;
+
+    frame->refs = 1;
+    frame->len = (uint32_t)len;
+    return frame;
+}
+
+shared_frame_t* shared_frame_create(const uint8_t *data, size_t len) {
+    shared_frame_t *frame = shared_frame_alloc(len);
+    if (frame) {
+        memcpy(frame->data, data, len);
+    }
+    return frame;
+}
+
+void shared_frame_release(shared_frame_t *frame) {
+    if (__atomic_sub_fetch(&frame->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(frame);
+    }
+}
+
+static shared_frame_t* queue_at(connection_t *conn, uint32_t i) {
+    return conn->out_queue[(conn->out_first + i) & (conn->out_capacity - 1)];
+}
+
+// Drop the oldest frame from the queue
+static void queue_pop(connection_t *conn) {
+    shared_frame_release(queue_at(conn, 0));
+    conn->out_first = (conn->out_first + 1) & (conn->out_capacity - 1);
+    conn->out_count--;
+    conn->out_offset = 0;
+}
+
+void connection_destroy(connection_t *conn) {
+    if (!conn) return;
+
+    if (conn->fd >= 0 && conn->fd < table_capacity && table[conn->fd] == conn) {
+        table[conn->fd] = NULL;
+    }
+
+    timer_cancel(&conn->timer);
+    metrics_gauge_add(METRIC_QUEUED_BYTES, -(int64_t)conn->out_bytes);
+    if (conn->state == CONN_PRE_AUTH) {
+        metrics_gauge_add(METRIC_PRE_AUTH_CONNECTIONS, -1);
+    }
+    while (conn->out_count) {
+        queue_pop(conn);
+    }
+    free(conn->out_queue);
+    free(conn->catchup);
+    free(conn->rx);
+    free(conn);
+}
+
+void connection_schedule_close(connection_t *conn) {
+    if (conn->closing) return;
+
+    conn->closing = 1;
+    conn->next_closing = closing_head;
+    closing_head = conn;
+}
+
+connection_t* connection_next_closing() {
+    connection_t *conn = closing_head;
+    if (conn) {
+        closing_head = conn->next_closing;
+    }
+    return conn;
+}
+
+// Returns bytes written (possibly 0 when the socket buffer is full), -1 on a fatal error
+static ssize_t write_socket(connection_t *conn, struct iovec *iov, int count) {
+    // sendmsg rather than writev for MSG_NOSIGNAL
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    while (1) {
+        ssize_t bytes_sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (bytes_sent >= 0) {
+            metrics_count(METRIC_BYTES_OUT, bytes_sent);
+            return bytes_sent;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Send failed: %m");
+        return -1;
+    }
+}
+
+static int enqueue_frame(connection_t *conn, shared_frame_t *frame) {
+    if (conn->out_count == conn->out_capacity) {
+        uint32_t capacity = conn->out_capacity ? conn->out_capacity * 2 : 16;
+        shared_frame_t **grown = malloc(capacity * sizeof(shared_frame_t*));
+        if (!grown) return -1;
+
+        // Unwrap the ring into the new array
+        for (uint32_t i = 0; i < conn->out_count; i++) {
+            grown[i] = queue_at(conn, i);
+        }
+        free(conn->out_queue);
+        conn->out_queue = grown;
+        conn->out_first = 0;
+        conn->out_capacity = capacity;
+    }
+
+    conn->out_queue[(conn->out_first + conn->out_count) & (conn->out_capacity - 1)] = shared_frame_retain(frame);
+    conn->out_count++;
+    conn->out_bytes += frame->len;
+    metrics_gauge_add(METRIC_QUEUED_BYTES, frame->len);
+    return 0;
+}
+
+int connection_send_shared(connection_t *conn, shared_frame_t *frame) {
+    if (!conn || conn->closing) return -1;
+
+    int was_empty = conn->out_count == 0;
+    if (!was_empty) {
+        // Apply the slow-consumer policy before queueing more
+        if (conn->out_bytes + frame->len > server_config.send_high_water) {
+            if (server_config.slow_consumer == SLOW_CONSUMER_DISCONNECT) {
+                LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Disconnecting slow client on socket %d (%zu bytes queued)",
+                                 conn->fd, conn->out_bytes);
+                connection_schedule_close(conn);
+                metrics_count(METRIC_SLOW_DISCONNECTS, 1);
+            } else {
+                conn->frames_dropped++;
+                metrics_count(METRIC_FRAMES_DROPPED, 1);
+            }
+            return -1;
+        }
+    }
+
+    if (enqueue_frame(conn, frame) < 0) {
+        connection_schedule_close(conn);
+        return -1;
+    }
+
+    // A queue that was already non-empty is either on the flush list or
+    // waiting for EPOLLOUT, and a write now would only return EAGAIN
+    if (was_empty && !conn->flush_pending) {
+        conn->flush_pending = 1;
+        conn->next_flush = flush_head;
+        flush_head = conn;
+    }
+    return 0;
+}
+
+int connection_send(connection_t *conn, const uint8_t *data, size_t len) {
+    if (!conn || conn->closing) return -1;
+
+    shared_frame_t *frame = shared_frame_create(data, len);
+    if (!frame) {
+        connection_schedule_close(conn);
+        return -1;
+    }
+    int result = connection_send_shared(conn, frame);
+    shared_frame_release(frame);
+    return result;
+}
+
+void connection_flush(connection_t *conn) {
+    while (conn->out_count && !conn->closing) {
+        struct iovec iov[FLUSH_MAX_IOV];
+        int count = 0;
+        size_t batch_bytes = 0;
+        while ((uint32_t)count < conn->out_count && count < FLUSH_MAX_IOV) {
+            shared_frame_t *frame = queue_at(conn, count);
+            size_t skip = count == 0 ? conn->out_offset : 0;
+            iov[count].iov_base = frame->data + skip;
+            iov[count].iov_len = frame->len - skip;
+            batch_bytes += iov[count].iov_len;
+            count++;
+        }
+
+        ssize_t bytes_sent = write_socket(conn, iov, count);
+        if (bytes_sent < 0) {
+            connection_schedule_close(conn);
+            return;
+        }
+        conn->out_bytes -= bytes_sent;
+        metrics_gauge_add(METRIC_QUEUED_BYTES, -bytes_sent);
+
+        // Retire the frames that went out in full; a partially written one
+        // stays at the head so the stream remains intact
+        size_t left = bytes_sent;
+        while (left > 0) {
+            size_t remaining = queue_at(conn, 0)->len - conn->out_offset;
+            if (left < remaining) {
+                conn->out_offset += left;
+                break;
+            }
+
+            left -= remaining;
+            queue_pop(conn);
+            metrics_count(METRIC_FRAMES_OUT, 1);
+        }
+
+        if ((size_t)bytes_sent < batch_bytes) {
+            return; // Socket full; EPOLLOUT fires again once it drains
+        }
+    }
+}
+
+void connection_flush_pending() {
+    while (flush_head) {
+        connection_t *conn = flush_head;
+        flush_head = conn->next_flush;
+        conn->flush_pending = 0;
+        connection_flush(conn);
+    }
+}
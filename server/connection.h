@@ -0,0 +1,97 @@
+#ifndef SERVER_CONNECTION_H
+#define SERVER_CONNECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../common/frame.h"
+#include "timer.h"
+
+// Encoded frame, immutable once built. A broadcast encodes its frame once
+// and every recipient's queue holds a reference to the same bytes; the last
+// queue to finish with it frees it. References are dropped on whichever
+// reactor thread owns the queue, so the count is atomic.
+typedef struct {
+    uint32_t refs;
+    uint32_t len;
+    uint8_t data[];
+} shared_frame_t;
+
+// Returns a frame with one reference and room for len bytes, or NULL
+shared_frame_t* shared_frame_alloc(size_t len);
+shared_frame_t* shared_frame_create(const uint8_t *data, size_t len);
+
+static inline shared_frame_t* shared_frame_retain(shared_frame_t *frame) {
+    __atomic_fetch_add(&frame->refs, 1, __ATOMIC_RELAXED);
+    return frame;
+}
+
+void shared_frame_release(shared_frame_t *frame);
+
+// Where a connection is in its lifecycle. Every accepted socket is in the
+// connection table from the start, but only a successful login ties it to a
+// user in the registry; until then it can only log in, register, log out or
+// exchange pings, and closing it never touches the registry.
+typedef enum {
+    CONN_PRE_AUTH,
+    CONN_AUTHENTICATED
+} connection_state_t;
+
+// Per-connection state, registered with the reactor once at accept time
+typedef struct connection {
+    int fd;
+    uint32_t id;              // Unique per connection, unlike fds which get reused
+    connection_state_t state;
+    frame_buffer_t *rx;       // Allocated on first input so idle sockets stay small
+    shared_frame_t **out_queue; // Ring of frames waiting to be written
+    uint32_t out_first;       // Ring index of the oldest frame
+    uint32_t out_count;
+    uint32_t out_capacity;    // Power of two, grown on demand
+    size_t out_offset;        // Bytes of the oldest frame already written
+    size_t out_bytes;         // Unsent bytes in the outbound queue
+    uint64_t frames_dropped;  // Frames discarded by the slow-consumer policy
+    int auth_pending;         // Input is paused while a login/register is with the auth workers
+    wheel_timer_t timer;      // Next liveness check: login deadline, ping or idle timeout
+    uint64_t login_deadline;  // timer_now() by which a pre-auth connection must have logged in
+    uint64_t last_active;     // timer_now() of the last read; the only per-read upkeep
+    uint64_t ping_sent;       // When our unanswered ping went out, 0 if none is outstanding
+    struct catchup *catchup;  // Missed messages still to send after login; see catchup.h
+    int closing;              // Set once the connection is scheduled for close
+    int flush_pending;        // On this tick's flush list
+    struct connection *next_closing;
+    struct connection *next_flush;
+} connection_t;
+
+// Connection table (indexed by fd); one per reactor thread, covering the
+// connections that thread owns. Call init/destroy on the owning thread.
+int connection_table_init(int capacity);
+void connection_table_destroy();
+connection_t* connection_lookup(int fd);
+
+// Connection lifecycle. New connections start in CONN_PRE_AUTH, with the
+// login deadline armed on the thread's timer wheel (see timer.h).
+connection_t* connection_create(int fd);
+void connection_destroy(connection_t *conn);
+void connection_set_state(connection_t *conn, connection_state_t state);
+// Record input. Timers are not touched: the armed check looks at last_active
+// when it fires and re-arms from there.
+static inline void connection_touch(connection_t *conn) {
+    conn->last_active = timer_now();
+    conn->ping_sent = 0;
+}
+// Closing is deferred to the end of the loop iteration so no handler sees a freed connection
+void connection_schedule_close(connection_t *conn);
+connection_t* connection_next_closing();
+
+// Outbound functions
+// Queue a frame. Nothing is written until the end of the loop iteration, so
+// every frame a connection receives in one tick goes out in a single writev.
+// Returns 0 if queued, -1 if dropped or the connection is closing.
+int connection_send(connection_t *conn, const uint8_t *frame, size_t len);
+// Same, queueing a reference to the frame instead of a copy
+int connection_send_shared(connection_t *conn, shared_frame_t *frame);
+// Write as much of the queue as the socket accepts
+void connection_flush(connection_t *conn);
+// Flush every connection that was sent to since the last call
+void connection_flush_pending();
+
+#endif // SERVER_CONNECTION_H
@@ -0,0 +1,177 @@
+#include "credentials.h"
+#include "password.h"
+#include "logger.h"
+#include "../common/hashmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#define MAX_LINE_LEN 256
+#define LOG_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    char username[MAX_USERNAME_LEN];
+    char record[PASSWORD_RECORD_LEN];
+} credential_t;
+
+static hashmap_t *credentials = NULL;
+static FILE *log_file = NULL;
+static int pending_records = 0;
+static struct timespec first_pending;
+// Every reactor thread logs users in and registers them; one lock covers the map and the log
+static pthread_mutex_t credentials_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static int store_credential(const char *username, const char *record) {
+    credential_t *credential = malloc(sizeof(credential_t));
+    if (!credential) return 0;
+
+    strncpy(credential->username, username, MAX_USERNAME_LEN - 1);
+    credential->username[MAX_USERNAME_LEN - 1] = '\0';
+    strncpy(credential->record, record, PASSWORD_RECORD_LEN - 1);
+    credential->record[PASSWORD_RECORD_LEN - 1] = '\0';
+
+    if (!hashmap_put(credentials, credential->username, credential)) {
+        free(credential);
+        return 0;
+    }
+    return 1;
+}
+
+static int load_credentials(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) return 0; // No users yet
+
+    char line[MAX_LINE_LEN];
+    char stored_username[MAX_USERNAME_LEN];
+    char stored_record[PASSWORD_RECORD_LEN];
+    int loaded = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%31[^:]:%159s", stored_username, stored_record) == 2) {
+            // Keep the first registration, matching the old first-match scan
+            if (!hashmap_get(credentials, stored_username) &&
+                store_credential(stored_username, stored_record)) {
+                loaded++;
+            }
+        }
+    }
+
+    fclose(file);
+    return loaded;
+}
+
+int credentials_open(const char *path) {
+    credentials = hashmap_create(1024);
+    if (!credentials) return -1;
+
+    int loaded = load_credentials(path);
+
+    log_file = fopen(path, "a");
+    if (!log_file) {
+        LOG_ERROR("Failed to open users file: %m");
+        return -1;
+    }
+    setvbuf(log_file, NULL, _IOFBF, LOG_BUFFER_SIZE);
+
+    LOG_INFO("Loaded %d registered users from %s", loaded, path);
+    return 0;
+}
+
+// Hands the buffered records to the kernel; returns the fd to fsync, or -1.
+// Call with credentials_lock held (or with no other thread running).
+static int flush_log() {
+    if (!log_file || pending_records == 0) return -1;
+
+    __atomic_store_n(&pending_records, 0, __ATOMIC_RELAXED);
+    if (fflush(log_file) != 0) {
+        LOG_ERROR("Failed to write users file: %m");
+        return -1;
+    }
+    return fileno(log_file);
+}
+
+// Outside the lock: the disk wait holds up neither logins nor other shards
+static void sync_fd(int fd) {
+    if (fd >= 0 && fsync(fd) != 0) {
+        LOG_ERROR("Failed to sync users file: %m");
+    }
+}
+
+void credentials_close() {
+    sync_fd(flush_log());
+    if (log_file) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+
+    if (credentials) {
+        for (uint32_t i = 0; i < credentials->capacity; i++) {
+            free(credentials->entries[i].value);
+        }
+        hashmap_destroy(credentials);
+        credentials = NULL;
+    }
+}
+
+int credentials_lookup(const char *username, char *record) {
+    pthread_mutex_lock(&credentials_lock);
+    credential_t *credential = hashmap_get(credentials, username);
+    if (credential) {
+        memcpy(record, credential->record, PASSWORD_RECORD_LEN);
+    }
+    pthread_mutex_unlock(&credentials_lock);
+    return credential != NULL;
+}
+
+int credentials_add(const char *username, const char *record) {
+    pthread_mutex_lock(&credentials_lock);
+    if (!log_file || hashmap_get(credentials, username) ||
+        !store_credential(username, record)) {
+        pthread_mutex_unlock(&credentials_lock);
+        return 0;
+    }
+
+    // Buffered append; made durable by the next batched sync
+    fprintf(log_file, "%s:%s\n", username, record);
+    if (__atomic_fetch_add(&pending_records, 1, __ATOMIC_RELAXED) == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &first_pending);
+    }
+    pthread_mutex_unlock(&credentials_lock);
+    return 1;
+}
+
+void credentials_sync_if_due() {
+    // Unlocked peek: a stale read only delays the sync to the next iteration
+    if (__atomic_load_n(&pending_records, __ATOMIC_RELAXED) == 0) return;
+
+    int fd = -1;
+    pthread_mutex_lock(&credentials_lock);
+    if (pending_records >= CREDENTIALS_SYNC_BATCH ||
+        (pending_records > 0 && elapsed_ms(&first_pending) >= CREDENTIALS_SYNC_INTERVAL_MS)) {
+        fd = flush_log();
+    }
+    pthread_mutex_unlock(&credentials_lock);
+    sync_fd(fd);
+}
+
+int credentials_sync_timeout() {
+    if (__atomic_load_n(&pending_records, __ATOMIC_RELAXED) == 0) return -1;
+
+    int timeout = -1;
+    pthread_mutex_lock(&credentials_lock);
+    if (pending_records > 0) {
+        long remaining = CREDENTIALS_SYNC_INTERVAL_MS - elapsed_ms(&first_pending);
+        timeout = remaining > 0 ? (int)remaining : 0;
+    }
+    pthread_mutex_unlock(&credentials_lock);
+    return timeout;
+}
@@ -0,0 +1,31 @@
+#ifndef SERVER_CREDENTIALS_H
+#define SERVER_CREDENTIALS_H
+
+#include "../common/protocol.h"
+
+// Registrations are fsync'd together once this many are pending...
+#define CREDENTIALS_SYNC_BATCH 64
+// ...or once the oldest pending one is this old
+#define CREDENTIALS_SYNC_INTERVAL_MS 50
+
+// In-memory credential store. The users file is parsed once at startup;
+// lookups are a hash probe and new registrations are appended to the file
+// through a buffered log that is fsync'd in batches.
+int credentials_open(const char *path);
+void credentials_close();
+
+// Copies the stored password record for username into record
+// (PASSWORD_RECORD_LEN bytes, see password.h); returns 1 if found, 0 if not
+// registered. Safe from any thread.
+int credentials_lookup(const char *username, char *record);
+// Returns 1 if added, 0 if the user already exists or on failure
+int credentials_add(const char *username, const char *record);
+
+// Group commit: flush and fsync pending registrations if a batch is due.
+// Call once per event-loop iteration; any reactor thread may do the sync.
+// Only the flush holds the credentials lock; the fsync runs after it.
+void credentials_sync_if_due();
+// Milliseconds until pending registrations are due, or -1 if none are pending
+int credentials_sync_timeout();
+
+#endif // SERVER_CREDENTIALS_H
@@ -0,0 +1,526 @@
+#include "history.h"
+#include "auth.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEGMENT_SUFFIX ".log"
+#define GROUP_PATH_LEN (PATH_MAX - 32) // Leaves room for a segment file name
+#define SEGMENT_MAGIC 0x54534843u    // "CHST"
+#define SEGMENT_VERSION 1            // Records carry compact chat payloads (protocol 3)
+
+// Start of every segment file, so segments written in another format are
+// caught at startup rather than replayed as malformed chat
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t base_seq;
+} segment_header_t;
+
+#define SEGMENT_DATA_START sizeof(segment_header_t)
+
+// On-disk record: header, then `length` payload bytes, padded to 8 bytes
+typedef struct {
+    uint32_t length;   // Written last; 0 marks the end of the log
+    uint32_t reserved;
+    uint64_t seq;
+} record_header_t;
+
+typedef struct {
+    uint64_t seq;
+    size_t offset;
+} index_entry_t;
+
+typedef struct {
+    uint64_t base_seq;       // Sequence number of the first record
+    uint8_t *map;
+    size_t mapped;           // File size when mapped; records never go past it
+    size_t committed;        // End of the complete records; readers load it with acquire
+    uint32_t records;
+    index_entry_t *index;    // Written under the log lock
+    uint32_t index_count;
+    uint32_t index_capacity;
+} segment_t;
+
+struct group_log {
+    pthread_mutex_t lock;
+    char path[GROUP_PATH_LEN]; // The group's directory
+    segment_t **segments;    // Oldest first; only the last one is appended to
+    uint32_t segment_count;
+    uint32_t segment_capacity;
+    uint64_t next_seq;
+};
+
+static char history_dir[PATH_MAX];
+static int history_enabled = 0;
+
+static size_t record_size(uint32_t length) {
+    return (sizeof(record_header_t) + length + 7) & ~(size_t)7;
+}
+
+// Group names can hold any byte, so directories are named by the name in hex
+static void group_dir_path(const char *name, char *path) {
+    int n = snprintf(path, GROUP_PATH_LEN, "%s/", history_dir);
+    for (const char *c = name; *c && n < GROUP_PATH_LEN - 3; c++) {
+        n += snprintf(path + n, GROUP_PATH_LEN - n, "%02x", (unsigned char)*c);
+    }
+}
+
+static int group_name_from_dir(const char *dir_name, char *name) {
+    size_t len = strlen(dir_name);
+    if (len == 0 || len % 2 || len / 2 >= MAX_GROUP_NAME_LEN) return 0;
+
+    for (size_t i = 0; i < len / 2; i++) {
+        unsigned value;
+        if (sscanf(dir_name + 2 * i, "%2x", &value) != 1 || value == 0) return 0;
+        name[i] = (char)value;
+    }
+    name[len / 2] = '\0';
+    return 1;
+}
+
+static void segment_path(const group_log_t *log, uint64_t base_seq, char *path) {
+    snprintf(path, PATH_MAX, "%s/%020llu" SEGMENT_SUFFIX, log->path, (unsigned long long)base_seq);
+}
+
+static int index_add(segment_t *segment, uint64_t seq, size_t offset) {
+    if (segment->index_count == segment->index_capacity) {
+        uint32_t capacity = segment->index_capacity ? segment->index_capacity * 2 : 16;
+        index_entry_t *grown = realloc(segment->index, capacity * sizeof(index_entry_t));
+        if (!grown) return -1;
+
+        segment->index = grown;
+        segment->index_capacity = capacity;
+    }
+    segment->index[segment->index_count].seq = seq;
+    segment->index[segment->index_count].offset = offset;
+    segment->index_count++;
+    return 0;
+}
+
+// Map a segment file, growing it to `size` bytes first if it is shorter
+static segment_t* segment_map(const char *path, uint64_t base_seq, size_t size, int create) {
+    int fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+    if (fd < 0) {
+        LOG_RATE_LIMITED(LOG_ERROR, LOG_EVENT_RATE, "Failed to open %s: %m", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || ((size_t)st.st_size < size && ftruncate(fd, size) < 0)) {
+        LOG_RATE_LIMITED(LOG_ERROR, LOG_EVENT_RATE, "Failed to size %s: %m", path);
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size > size) {
+        size = st.st_size;
+    }
+
+    // The mapping keeps the file open
+    uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOG_RATE_LIMITED(LOG_ERROR, LOG_EVENT_RATE, "Failed to map %s: %m", path);
+        return NULL;
+    }
+
+    segment_t *segment = calloc(1, sizeof(segment_t));
+    if (!segment) {
+        munmap(map, size);
+        return NULL;
+    }
+    segment->base_seq = base_seq;
+    segment->map = map;
+    segment->mapped = size;
+    segment->committed = SEGMENT_DATA_START;
+    if (create) {
+        segment_header_t *header = (segment_header_t*)map;
+        header->magic = SEGMENT_MAGIC;
+        header->version = SEGMENT_VERSION;
+        header->reserved = 0;
+        header->base_seq = base_seq;
+    }
+    return segment;
+}
+
+static void segment_unmap(segment_t *segment) {
+    msync(segment->map, segment->committed, MS_SYNC);
+    munmap(segment->map, segment->mapped);
+    free(segment->index);
+    free(segment);
+}
+
+// Check a reopened segment's header and walk its records to find where it
+// ends. Fails if the segment was not written in this format.
+static int segment_recover(segment_t *segment, const char *path) {
+    segment_header_t *segment_header = (segment_header_t*)segment->map;
+    if (segment->mapped < SEGMENT_DATA_START || segment_header->magic != SEGMENT_MAGIC ||
+        segment_header->version != SEGMENT_VERSION || segment_header->base_seq != segment->base_seq) {
+        LOG_ERROR("History segment %s is not in format version %d; "
+                  "move the history directory aside to start with empty history", path, SEGMENT_VERSION);
+        return -1;
+    }
+
+    size_t offset = SEGMENT_DATA_START;
+    uint64_t seq = segment->base_seq;
+    while (offset + sizeof(record_header_t) <= segment->mapped) {
+        record_header_t *header = (record_header_t*)(segment->map + offset);
+        if (header->length == 0 || header->length > MAX_PAYLOAD_LEN || header->seq != seq ||
+            offset + record_size(header->length) > segment->mapped) {
+            break;
+        }
+
+        if (segment->records % HISTORY_INDEX_INTERVAL == 0) {
+            index_add(segment, seq, offset);
+        }
+        segment->records++;
+        offset += record_size(header->length);
+        seq++;
+    }
+    segment->committed = offset;
+    return 0;
+}
+
+static int log_add_segment(group_log_t *log, segment_t *segment) {
+    if (log->segment_count == log->segment_capacity) {
+        uint32_t capacity = log->segment_capacity ? log->segment_capacity * 2 : 4;
+        segment_t **grown = realloc(log->segments, capacity * sizeof(segment_t*));
+        if (!grown) return -1;
+
+        log->segments = grown;
+        log->segment_capacity = capacity;
+    }
+    log->segments[log->segment_count++] = segment;
+    return 0;
+}
+
+static group_log_t* log_create(const char *group_name) {
+    group_log_t *log = calloc(1, sizeof(group_log_t));
+    if (!log) return NULL;
+
+    pthread_mutex_init(&log->lock, NULL);
+    group_dir_path(group_name, log->path);
+    log->next_seq = 1;
+    return log;
+}
+
+static void log_destroy(group_log_t *log) {
+    for (uint32_t i = 0; i < log->segment_count; i++) {
+        segment_unmap(log->segments[i]);
+    }
+    free(log->segments);
+    pthread_mutex_destroy(&log->lock);
+    free(log);
+}
+
+static int compare_seq(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Reopen every segment of one group, oldest first. Fails if the directory
+// cannot be read or holds a segment in another format.
+static int log_recover(group_log_t *log) {
+    DIR *dir = opendir(log->path);
+    if (!dir) {
+        LOG_ERROR("Failed to open history directory %s: %m", log->path);
+        return -1;
+    }
+
+    uint64_t *bases = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        unsigned long long base;
+        char suffix[8];
+        if (sscanf(entry->d_name, "%20llu%7s", &base, suffix) != 2 || strcmp(suffix, SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            uint64_t *grown = realloc(bases, capacity * sizeof(uint64_t));
+            if (!grown) break;
+            bases = grown;
+        }
+        bases[count++] = base;
+    }
+    closedir(dir);
+    qsort(bases, count, sizeof(uint64_t), compare_seq);
+
+    for (size_t i = 0; i < count; i++) {
+        // Segments only move forward; a gap is a failed append and is kept
+        if (bases[i] < log->next_seq) {
+            LOG_WARN("Skipping overlapping history segment %llu in %s",
+                     (unsigned long long)bases[i], log->path);
+            continue;
+        }
+
+        char path[PATH_MAX];
+        segment_path(log, bases[i], path);
+        int last = i + 1 == count;
+        segment_t *segment = segment_map(path, bases[i], last ? HISTORY_SEGMENT_SIZE : 0, 0);
+        if (!segment) continue;
+
+        if (segment_recover(segment, path) < 0) {
+            segment_unmap(segment);
+            free(bases);
+            return -1;
+        }
+        if (log_add_segment(log, segment) < 0) {
+            segment_unmap(segment);
+            break;
+        }
+        log->next_seq = segment->base_seq + segment->records;
+    }
+    free(bases);
+    return 0;
+}
+
+// Whether a history directory entry is itself a directory; d_type is not
+// filled in by every file system
+static int is_directory(DIR *parent, const struct dirent *entry) {
+    if (entry->d_type != DT_UNKNOWN) {
+        return entry->d_type == DT_DIR;
+    }
+    struct stat st;
+    return fstatat(dirfd(parent), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+}
+
+int history_open(const char *dir, list_t *groups) {
+    snprintf(history_dir, sizeof(history_dir), "%s", dir);
+    if (mkdir(history_dir, 0755) < 0 && errno != EEXIST) {
+        LOG_ERROR("Failed to create history directory %s: %m", history_dir);
+        return -1;
+    }
+
+    DIR *top = opendir(history_dir);
+    if (!top) {
+        LOG_ERROR("Failed to open history directory %s: %m", history_dir);
+        return -1;
+    }
+
+    int restored = 0;
+    int failed = 0;
+    struct dirent *entry;
+    while ((entry = readdir(top))) {
+        char name[MAX_GROUP_NAME_LEN];
+        if (!group_name_from_dir(entry->d_name, name) || group_list_find_by_name(groups, name)) {
+            continue;
+        }
+        if (!is_directory(top, entry)) {
+            LOG_WARN("Ignoring %s/%s in the history directory: not a directory", history_dir, entry->d_name);
+            continue;
+        }
+
+        group_t *group = create_group(name);
+        group_log_t *log = log_create(name);
+        if (!group || !log) {
+            destroy_group(group);
+            free(log);
+            continue;
+        }
+        group->history = log;
+        group_list_add(groups, group);
+        if (log_recover(log) < 0) {
+            failed = 1;
+            break;
+        }
+        restored++;
+    }
+    closedir(top);
+    if (failed) {
+        return -1;
+    }
+
+    history_enabled = 1;
+    LOG_INFO("Restored history of %d groups from %s", restored, history_dir);
+    return 0;
+}
+
+void history_close(list_t *groups) {
+    if (!groups) return;
+
+    for (list_node_t *node = groups->head; node; node = node->next) {
+        group_t *group = (group_t*)node->data;
+        if (group->history) {
+            log_destroy(group->history);
+            group->history = NULL;
+        }
+    }
+}
+
+int history_attach(group_t *group) {
+    if (!history_enabled) return 0;
+
+    group->history = log_create(group->name);
+    return group->history ? 0 : -1;
+}
+
+uint64_t history_lock(group_log_t *log) {
+    pthread_mutex_lock(&log->lock);
+    return log->next_seq;
+}
+
+void history_unlock(group_log_t *log) {
+    pthread_mutex_unlock(&log->lock);
+}
+
+// Start a new segment at next_seq. Called with the lock held.
+static segment_t* start_segment(group_log_t *log) {
+    // Trim the full segment's file to what was written; its mapping stays
+    // valid for every byte a reader can reach
+    if (log->segment_count > 0) {
+        segment_t *full = log->segments[log->segment_count - 1];
+        char path[PATH_MAX];
+        segment_path(log, full->base_seq, path);
+        if (truncate(path, full->committed) < 0) {
+            LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Failed to trim %s: %m", path);
+        }
+    } else if (mkdir(log->path, 0755) < 0 && errno != EEXIST) {
+        LOG_RATE_LIMITED(LOG_ERROR, LOG_EVENT_RATE, "Failed to create %s: %m", log->path);
+        return NULL;
+    }
+
+    char path[PATH_MAX];
+    segment_path(log, log->next_seq, path);
+    segment_t *segment = segment_map(path, log->next_seq, HISTORY_SEGMENT_SIZE, 1);
+    if (segment && log_add_segment(log, segment) < 0) {
+        segment_unmap(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+void history_append(group_log_t *log, const void *payload, uint32_t len) {
+    uint64_t seq = log->next_seq;
+    size_t size = record_size(len);
+
+    segment_t *segment = log->segment_count ? log->segments[log->segment_count - 1] : NULL;
+    if (!segment || segment->committed + size > segment->mapped) {
+        segment = start_segment(log);
+    }
+    log->next_seq++;
+    if (!segment) {
+        return; // The message still goes out live; its seq is a gap in the history
+    }
+
+    uint8_t *at = segment->map + segment->committed;
+    record_header_t *header = (record_header_t*)at;
+    header->reserved = 0;
+    header->seq = seq;
+    memcpy(at + sizeof(record_header_t), payload, len);
+    __atomic_store_n(&header->length, len, __ATOMIC_RELEASE);
+
+    if (segment->records % HISTORY_INDEX_INTERVAL == 0) {
+        index_add(segment, seq, segment->committed);
+    }
+    segment->records++;
+    __atomic_store_n(&segment->committed, segment->committed + size, __ATOMIC_RELEASE);
+}
+
+// Segment holding seq (the first one if seq predates them all), and the
+// offset of the index entry at or before it. Called with the lock held.
+static uint32_t find_start(group_log_t *log, uint64_t seq, size_t *offset) {
+    uint32_t lo = 0;
+    uint32_t hi = log->segment_count;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (log->segments[mid]->base_seq <= seq) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    segment_t *segment = log->segments[lo];
+    *offset = SEGMENT_DATA_START;
+    uint32_t a = 0;
+    uint32_t b = segment->index_count;
+    while (a < b) {
+        uint32_t mid = (a + b) / 2;
+        if (segment->index[mid].seq <= seq) {
+            *offset = segment->index[mid].offset;
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+    return lo;
+}
+
+uint64_t history_next_seq(group_log_t *log) {
+    pthread_mutex_lock(&log->lock);
+    uint64_t next = log->next_seq;
+    pthread_mutex_unlock(&log->lock);
+    return next;
+}
+
+uint64_t history_read(group_log_t *log, uint64_t since, uint64_t until,
+                      history_visit_t visit, void *arg, int *more) {
+    *more = 0;
+    if (since == 0) {
+        since = 1;
+    }
+
+    pthread_mutex_lock(&log->lock);
+    if (log->segment_count == 0 || since >= log->next_seq) {
+        uint64_t next = since < log->next_seq ? since : log->next_seq;
+        pthread_mutex_unlock(&log->lock);
+        return next;
+    }
+    size_t offset;
+    uint32_t current = find_start(log, since, &offset);
+    segment_t *segment = log->segments[current];
+    pthread_mutex_unlock(&log->lock);
+
+    // Records below `committed` never change, so they are copied out without
+    // the lock and appends to the group carry on meanwhile
+    uint64_t next = since;
+    uint32_t messages = 0;
+    size_t bytes = 0;
+    while (segment) {
+        size_t committed = __atomic_load_n(&segment->committed, __ATOMIC_ACQUIRE);
+        while (offset < committed) {
+            record_header_t *header = (record_header_t*)(segment->map + offset);
+            if (header->seq >= until) {
+                return next;
+            }
+            if (header->seq >= since) {
+                if (messages == HISTORY_BATCH_MESSAGES || bytes + header->length > HISTORY_BATCH_BYTES) {
+                    // Start paging in the next batch while this one is sent
+                    size_t page = offset & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+                    size_t end = offset + HISTORY_BATCH_BYTES < committed ? offset + HISTORY_BATCH_BYTES : committed;
+                    madvise(segment->map + page, end - page, MADV_WILLNEED);
+                    *more = 1;
+                    return next;
+                }
+                if (visit(header->seq, segment->map + offset + sizeof(record_header_t), header->length, arg) < 0) {
+                    *more = 1;
+                    return header->seq;
+                }
+                messages++;
+                bytes += header->length;
+                next = header->seq + 1;
+            }
+            offset += record_size(header->length);
+        }
+
+        pthread_mutex_lock(&log->lock);
+        segment = current + 1 < log->segment_count ? log->segments[++current] : NULL;
+        pthread_mutex_unlock(&log->lock);
+        offset = SEGMENT_DATA_START;
+    }
+    return next;
+}
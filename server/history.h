@@ -0,0 +1,60 @@
+#ifndef SERVER_HISTORY_H
+#define SERVER_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../common/protocol.h"
+#include "../common/list.h"
+
+#define DEFAULT_HISTORY_DIR "history"
+#define HISTORY_SEGMENT_SIZE (4 * 1024 * 1024)
+#define HISTORY_INDEX_INTERVAL 64        // Records per sparse index entry
+#define HISTORY_BATCH_MESSAGES 256       // Most messages one fetch returns...
+#define HISTORY_BATCH_BYTES (64 * 1024)  // ...and most payload bytes
+
+// Persistent per-group message history. Each group has a directory of
+// append-only segment files, named by the sequence number of their first
+// record and memory-mapped, so appends are a memcpy and catch-up reads copy
+// straight out of the page cache. A sparse in-memory index (one entry every
+// HISTORY_INDEX_INTERVAL records) finds the starting point of a read.
+//
+// Records hold the chat payload as broadcast, less its leading group ID and
+// seq (see chat_encode_prefix), which are put back when it is replayed; so
+// group IDs, which are assigned afresh at every start, never reach the disk.
+// A record's length is written last, so a torn append reads back as the end
+// of the log. Each segment starts with a magic number and format version;
+// history_open fails on a segment in any other format.
+typedef struct group_log group_log_t;
+
+// Open (creating if needed) the history directory and restore every group
+// found there into groups. Only messages are stored: memberships are not,
+// so restored groups have no members and users join again after a restart.
+// Entries that are not group directories are skipped; an unreadable group
+// directory or a segment in another format fails. Call before any thread starts.
+int history_open(const char *dir, list_t *groups);
+// Sync and unmap everything; call after every thread has stopped
+void history_close(list_t *groups);
+
+// Give a newly created group a (still empty) log. Call under the registry write lock.
+int history_attach(group_t *group);
+
+// Appending. history_lock holds the group's log and returns the sequence
+// number the next append gets; holding it across the fan-out as well keeps
+// every recipient's copy of a group in sequence order.
+uint64_t history_lock(group_log_t *log);
+void history_append(group_log_t *log, const void *payload, uint32_t len);
+void history_unlock(group_log_t *log);
+
+// Sequence number the next message will get
+uint64_t history_next_seq(group_log_t *log);
+
+// Reading; safe alongside appends. Calls visit for each stored payload with
+// since <= seq < until, oldest first, until the batch limits are reached or
+// visit returns -1 (the record was not taken, e.g. the frame was dropped).
+// Returns the sequence number to continue from and sets *more if the batch
+// was cut short.
+typedef int (*history_visit_t)(uint64_t seq, const uint8_t *payload, uint32_t len, void *arg);
+uint64_t history_read(group_log_t *log, uint64_t since, uint64_t until,
+                      history_visit_t visit, void *arg, int *more);
+
+#endif // SERVER_HISTORY_H
@@ -0,0 +1,217 @@
+#include "logger.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+
+// Bounded MPSC ring (Vyukov). A slot is free for the producer claiming
+// position p when its sequence equals p, and ready for the writer when it
+// equals p + 1.
+typedef struct {
+    uint64_t sequence;
+    log_level_t level;
+    struct timespec time;
+    char text[LOG_LINE_LEN];
+} log_slot_t;
+
+static log_slot_t ring[LOG_RING_CAPACITY];
+static uint64_t enqueue_pos = 0;
+static uint64_t dequeue_pos = 0; // Writer thread only
+static uint64_t dropped = 0;
+
+static pthread_t writer_thread;
+static int running = 0;
+static int stopping = 0;
+
+// An idle writer sleeps on wake_cond. It sets writer_idle before its last
+// look at the ring, and producers check it after publishing, so a line is
+// never left waiting; while the writer is busy, logging takes no lock.
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+static int writer_idle = 0;
+
+log_level_t log_min_level = LOG_INFO;
+
+static const char *level_names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+int log_parse_level(const char *name) {
+    for (int i = LOG_DEBUG; i <= LOG_ERROR; i++) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void write_line(log_level_t level, const struct timespec *time, const char *text) {
+    struct tm local;
+    char stamp[32];
+    localtime_r(&time->tv_sec, &local);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    printf("%s.%03ld %-5s %s\n", stamp, time->tv_nsec / 1000000, level_names[level], text);
+}
+
+// Drain everything ready; returns the number of lines written
+static int drain() {
+    int written = 0;
+    while (1) {
+        log_slot_t *slot = &ring[dequeue_pos & (LOG_RING_CAPACITY - 1)];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != dequeue_pos + 1) {
+            break;
+        }
+
+        write_line(slot->level, &slot->time, slot->text);
+        __atomic_store_n(&slot->sequence, dequeue_pos + LOG_RING_CAPACITY, __ATOMIC_RELEASE);
+        dequeue_pos++;
+        written++;
+    }
+
+    uint64_t lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+    if (lost) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        char text[64];
+        snprintf(text, sizeof(text), "%llu log lines dropped (buffer full)", (unsigned long long)lost);
+        write_line(LOG_WARN, &now, text);
+        written++;
+    }
+    return written;
+}
+
+// Whether the writer has anything to do
+static int ring_ready() {
+    log_slot_t *slot = &ring[dequeue_pos & (LOG_RING_CAPACITY - 1)];
+    return __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == dequeue_pos + 1 ||
+           __atomic_load_n(&dropped, __ATOMIC_RELAXED) != 0 ||
+           __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+}
+
+static void wake_writer() {
+    pthread_mutex_lock(&wake_lock);
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_lock);
+}
+
+static void* writer_run(void *arg) {
+    (void)arg;
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        if (drain() > 0) {
+            fflush(stdout);
+            continue;
+        }
+
+        pthread_mutex_lock(&wake_lock);
+        __atomic_store_n(&writer_idle, 1, __ATOMIC_SEQ_CST);
+        while (!ring_ready()) {
+            pthread_cond_wait(&wake_cond, &wake_lock);
+        }
+        __atomic_store_n(&writer_idle, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&wake_lock);
+    }
+    drain();
+    fflush(stdout);
+    return NULL;
+}
+
+int log_init(log_level_t min_level) {
+    log_min_level = min_level;
+    for (uint64_t i = 0; i < LOG_RING_CAPACITY; i++) {
+        ring[i].sequence = i;
+    }
+
+    // The writer flushes after every batch, so stdout can be fully buffered
+    setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+
+    if (pthread_create(&writer_thread, NULL, writer_run, NULL) != 0) {
+        perror("pthread_create failed");
+        return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+void log_shutdown() {
+    if (!running) return;
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+    wake_writer();
+    pthread_join(writer_thread, NULL);
+    running = 0;
+}
+
+void log_write(log_level_t level, const char *format, ...) {
+    va_list args;
+
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        // Before start or after shutdown: write directly
+        char text[LOG_LINE_LEN];
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        write_line(level, &now, text);
+        fflush(stdout);
+        return;
+    }
+
+    // Claim a slot
+    uint64_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    log_slot_t *slot;
+    while (1) {
+        slot = &ring[pos & (LOG_RING_CAPACITY - 1)];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(sequence - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // pos was reloaded by the failed exchange
+        } else if (diff < 0) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return; // Full
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->level = level;
+    clock_gettime(CLOCK_REALTIME, &slot->time);
+    va_start(args, format);
+    vsnprintf(slot->text, sizeof(slot->text), format, args);
+    va_end(args);
+
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    // Pairs with the writer setting writer_idle before it checks the ring
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writer_idle, __ATOMIC_RELAXED)) {
+        wake_writer();
+    }
+}
+
+int log_rate_allow(log_limit_t *limit, uint32_t per_second) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    if ((uint64_t)now.tv_sec != limit->second) {
+        if (limit->suppressed) {
+            log_write(LOG_WARN, "%u similar log lines suppressed", limit->suppressed);
+        }
+        limit->second = now.tv_sec;
+        limit->count = 0;
+        limit->suppressed = 0;
+    }
+
+    if (limit->count < per_second) {
+        limit->count++;
+        return 1;
+    }
+    limit->suppressed++;
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef SERVER_LOGGER_H
+#define SERVER_LOGGER_H
+
+#include <stdint.h>
+
+// Asynchronous leveled logger. Callers format into a slot of a lock-free
+// ring and return; a background thread writes the lines to stdout, so no
+// caller ever waits on I/O. When the ring is full, lines are dropped and
+// counted rather than stalling the caller.
+
+typedef enum {
+    LOG_DEBUG = 0,
+    LOG_INFO = 1,
+    LOG_WARN = 2,
+    LOG_ERROR = 3
+} log_level_t;
+
+#define LOG_LINE_LEN 512        // Longer lines are truncated
+#define LOG_RING_CAPACITY 4096  // Power of two
+
+// Start the writer thread; lines below min_level are discarded at the call site
+int log_init(log_level_t min_level);
+// Write out everything queued and stop the writer thread
+void log_shutdown();
+
+// Parse "debug", "info", "warn" or "error"; returns -1 if unknown
+int log_parse_level(const char *name);
+
+extern log_level_t log_min_level;
+
+static inline int log_enabled(log_level_t level) {
+    return level >= log_min_level;
+}
+
+// Any thread; formats with printf rules (including %m for errno)
+void log_write(log_level_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#define LOG_DEBUG(...) do { if (log_enabled(LOG_DEBUG)) log_write(LOG_DEBUG, __VA_ARGS__); } while (0)
+#define LOG_INFO(...) do { if (log_enabled(LOG_INFO)) log_write(LOG_INFO, __VA_ARGS__); } while (0)
+#define LOG_WARN(...) do { if (log_enabled(LOG_WARN)) log_write(LOG_WARN, __VA_ARGS__); } while (0)
+#define LOG_ERROR(...) do { if (log_enabled(LOG_ERROR)) log_write(LOG_ERROR, __VA_ARGS__); } while (0)
+
+// Per-message logs. Both keep their state per call site and per thread,
+// so they need no shared counters.
+
+// Defaults for per-connection events and per-message lines
+#define LOG_EVENT_RATE 20
+#define LOG_MESSAGE_SAMPLE 1000
+
+// Log one in every `every` calls
+#define LOG_SAMPLED(level, every, ...) do { \
+        static __thread uint32_t log_sample_; \
+        if (log_enabled(level) && log_sample_++ % (every) == 0) log_write(level, __VA_ARGS__); \
+    } while (0)
+
+// Log at most `per_second` lines a second; the rest are counted and reported
+// once the next second starts
+typedef struct {
+    uint64_t second;
+    uint32_t count;
+    uint32_t suppressed;
+} log_limit_t;
+
+int log_rate_allow(log_limit_t *limit, uint32_t per_second);
+
+#define LOG_RATE_LIMITED(level, per_second, ...) do { \
+        static __thread log_limit_t log_limit_; \
+        if (log_enabled(level) && log_rate_allow(&log_limit_, per_second)) log_write(level, __VA_ARGS__); \
+    } while (0)
+
+#endif // SERVER_LOGGER_H
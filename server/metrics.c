@@ -0,0 +1,323 @@
+#include "metrics.h"
+#include "auth_worker.h"
+#include "logger.h"
+#include "auth.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_METRIC_THREADS 512
+#define REQUEST_BUFFER_SIZE 1024
+
+static metrics_slot_t slots[MAX_METRIC_THREADS];
+static uint32_t slot_count = 0;
+
+__thread metrics_slot_t *metrics_local = NULL;
+
+static int admin_socket = -1;
+static pthread_t admin_thread;
+static int admin_running = 0;
+static int stopping = 0;
+
+// Indexed by message_type_t
+static const char *message_type_names[METRICS_MESSAGE_TYPES] = {
+    NULL, "login", "register", "login_response", "register_response", "join_group",
+    "create_group", "group_response", "chat_message", "leave_group", "logout",
+    "error", "success", "history_request", "history_response", "ping", "pong"
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    { "chat_bytes_received_total", "Bytes read from client sockets" },
+    { "chat_bytes_sent_total", "Bytes written to client sockets" },
+    { "chat_frames_sent_total", "Frames fully written to client sockets" },
+    { "chat_frames_dropped_total", "Frames discarded for slow consumers" },
+    { "chat_connections_opened_total", "Client connections accepted" },
+    { "chat_connections_closed_total", "Client connections closed" },
+    { "chat_slow_consumer_disconnects_total", "Clients disconnected by the slow-consumer policy" },
+    { "chat_fanout_deliveries_total", "Recipients reached by group broadcasts" },
+    { "chat_timeout_disconnects_total", "Clients disconnected for idling or not logging in in time" },
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} histogram_info[METRIC_HISTOGRAM_COUNT] = {
+    { "chat_dispatch_seconds", "Time to handle one inbound frame" },
+    { "chat_fanout_seconds", "Time to fan one chat message out to its group" },
+    { "chat_auth_seconds", "Login or registration time from queueing to completion" },
+};
+
+void metrics_register_thread() {
+    uint32_t index = __atomic_fetch_add(&slot_count, 1, __ATOMIC_RELAXED);
+    if (index < MAX_METRIC_THREADS) {
+        metrics_local = &slots[index];
+    }
+}
+
+static uint32_t histogram_bucket(uint64_t ns) {
+    if (ns < (1ull << METRICS_HISTOGRAM_MIN_SHIFT)) {
+        return 0;
+    }
+
+    uint32_t shift = 63 - __builtin_clzll(ns);
+    if (shift >= METRICS_HISTOGRAM_MAX_SHIFT) {
+        return METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    // The two bits below the leading one pick the quarter within this power of two
+    uint32_t sub = (ns >> (shift - 2)) & (METRICS_HISTOGRAM_SUB_BUCKETS - 1);
+    return 1 + (shift - METRICS_HISTOGRAM_MIN_SHIFT) * METRICS_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+// Exclusive upper bound of a bucket, in nanoseconds
+static uint64_t histogram_bucket_limit(uint32_t bucket) {
+    if (bucket == 0) {
+        return 1ull << METRICS_HISTOGRAM_MIN_SHIFT;
+    }
+    uint32_t shift = METRICS_HISTOGRAM_MIN_SHIFT + (bucket - 1) / METRICS_HISTOGRAM_SUB_BUCKETS;
+    uint32_t sub = (bucket - 1) % METRICS_HISTOGRAM_SUB_BUCKETS;
+    return (uint64_t)(METRICS_HISTOGRAM_SUB_BUCKETS + sub + 1) << (shift - 2);
+}
+
+void metrics_observe(metric_histogram_t histogram, uint64_t ns) {
+    if (!metrics_local) return;
+
+    metrics_histogram_t *h = &metrics_local->histograms[histogram];
+    metrics_relaxed_add(&h->buckets[histogram_bucket(ns)], 1);
+    metrics_relaxed_add(&h->sum_ns, ns);
+    metrics_relaxed_add(&h->count, 1);
+}
+
+static uint64_t load(const uint64_t *value) {
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+// Sum every registered slot into one snapshot
+static void collect(metrics_slot_t *total) {
+    memset(total, 0, sizeof(*total));
+
+    uint32_t count = __atomic_load_n(&slot_count, __ATOMIC_RELAXED);
+    if (count > MAX_METRIC_THREADS) count = MAX_METRIC_THREADS;
+
+    for (uint32_t s = 0; s < count; s++) {
+        const metrics_slot_t *slot = &slots[s];
+        for (int i = 0; i < METRICS_MESSAGE_TYPES; i++) {
+            total->messages[i] += load(&slot->messages[i]);
+        }
+        for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+            total->counters[i] += load(&slot->counters[i]);
+        }
+        for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+            total->gauges[i] += __atomic_load_n(&slot->gauges[i], __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+            for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++) {
+                total->histograms[i].buckets[b] += load(&slot->histograms[i].buckets[b]);
+            }
+            total->histograms[i].count += load(&slot->histograms[i].count);
+            total->histograms[i].sum_ns += load(&slot->histograms[i].sum_ns);
+        }
+    }
+}
+
+static void write_histogram(FILE *out, const char *name, const char *help, const metrics_histogram_t *h) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+    // Buckets are cumulative in the exposition format
+    uint64_t cumulative = 0;
+    for (uint32_t b = 0; b < METRICS_HISTOGRAM_BUCKETS - 1; b++) {
+        cumulative += h->buckets[b];
+        fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", name, histogram_bucket_limit(b) / 1e9,
+                (unsigned long long)cumulative);
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)h->count);
+    fprintf(out, "%s_sum %.9f\n", name, h->sum_ns / 1e9);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long)h->count);
+}
+
+static void write_pools(FILE *out) {
+    pool_t *pools[] = { &user_pool, &group_pool, &list_node_pool };
+    pool_stats_t stats[3];
+    for (int i = 0; i < 3; i++) {
+        pool_get_stats(pools[i], &stats[i]);
+    }
+
+    fprintf(out, "# HELP chat_pool_objects_in_use Objects allocated from each pool\n");
+    fprintf(out, "# TYPE chat_pool_objects_in_use gauge\n");
+    for (int i = 0; i < 3; i++) {
+        fprintf(out, "chat_pool_objects_in_use{pool=\"%s\"} %zu\n", stats[i].name, stats[i].in_use);
+    }
+    fprintf(out, "# HELP chat_pool_objects_high_water Most objects ever in use at once\n");
+    fprintf(out, "# TYPE chat_pool_objects_high_water gauge\n");
+    for (int i = 0; i < 3; i++) {
+        fprintf(out, "chat_pool_objects_high_water{pool=\"%s\"} %zu\n", stats[i].name, stats[i].high_water);
+    }
+    fprintf(out, "# HELP chat_pool_capacity_bytes Memory held by each pool's slabs\n");
+    fprintf(out, "# TYPE chat_pool_capacity_bytes gauge\n");
+    for (int i = 0; i < 3; i++) {
+        fprintf(out, "chat_pool_capacity_bytes{pool=\"%s\"} %zu\n", stats[i].name,
+                stats[i].capacity * stats[i].object_size);
+    }
+    fprintf(out, "# HELP chat_pool_capacity_objects Objects the pool can hand out before growing\n");
+    fprintf(out, "# TYPE chat_pool_capacity_objects gauge\n");
+    for (int i = 0; i < 3; i++) {
+        fprintf(out, "chat_pool_capacity_objects{pool=\"%s\"} %zu\n", stats[i].name, stats[i].capacity);
+    }
+}
+
+static void write_metrics(FILE *out) {
+    metrics_slot_t total;
+    collect(&total);
+
+    fprintf(out, "# HELP chat_messages_received_total Frames received by message type\n");
+    fprintf(out, "# TYPE chat_messages_received_total counter\n");
+    for (int i = 0; i < METRICS_MESSAGE_TYPES; i++) {
+        if (message_type_names[i]) {
+            fprintf(out, "chat_messages_received_total{type=\"%s\"} %llu\n",
+                    message_type_names[i], (unsigned long long)total.messages[i]);
+        }
+    }
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_info[i].name,
+                counter_info[i].help, counter_info[i].name, counter_info[i].name,
+                (unsigned long long)total.counters[i]);
+    }
+
+    fprintf(out, "# HELP chat_connections_open Client connections currently open\n");
+    fprintf(out, "# TYPE chat_connections_open gauge\n");
+    fprintf(out, "chat_connections_open %lld\n",
+            (long long)(total.counters[METRIC_CONNECTIONS_OPENED] - total.counters[METRIC_CONNECTIONS_CLOSED]));
+    fprintf(out, "# HELP chat_connections_unauthenticated Open connections that have not logged in\n");
+    fprintf(out, "# TYPE chat_connections_unauthenticated gauge\n");
+    fprintf(out, "chat_connections_unauthenticated %lld\n", (long long)total.gauges[METRIC_PRE_AUTH_CONNECTIONS]);
+    fprintf(out, "# HELP chat_outbound_queued_bytes Bytes waiting in client outbound queues\n");
+    fprintf(out, "# TYPE chat_outbound_queued_bytes gauge\n");
+    fprintf(out, "chat_outbound_queued_bytes %lld\n", (long long)total.gauges[METRIC_QUEUED_BYTES]);
+    fprintf(out, "# HELP chat_auth_queue_depth Logins and registrations waiting for a worker\n");
+    fprintf(out, "# TYPE chat_auth_queue_depth gauge\n");
+    fprintf(out, "chat_auth_queue_depth %d\n", auth_queue_length());
+    write_pools(out);
+
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        write_histogram(out, histogram_info[i].name, histogram_info[i].help, &total.histograms[i]);
+    }
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+static void serve_request(int client) {
+    // Don't let a silent client hold up the admin thread
+    struct timeval timeout = { 1, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char request[REQUEST_BUFFER_SIZE];
+    ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+    if (received <= 0) return;
+    request[received] = '\0';
+
+    if (strncmp(request, "GET /metrics", 12) != 0) {
+        const char *not_found = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        write_all(client, not_found, strlen(not_found));
+        return;
+    }
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *out = open_memstream(&body, &body_len);
+    if (!out) return;
+    write_metrics(out);
+    fclose(out);
+
+    char header[128];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\n\r\n", body_len);
+    if (write_all(client, header, header_len) == 0) {
+        write_all(client, body, body_len);
+    }
+    free(body);
+}
+
+static void* admin_run(void *arg) {
+    (void)arg;
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        int client = accept(admin_socket, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // Shut down by metrics_stop
+        }
+        serve_request(client);
+        close(client);
+    }
+    return NULL;
+}
+
+int metrics_start(int port) {
+    admin_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (admin_socket < 0) {
+        LOG_ERROR("Failed to create admin socket: %m");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(admin_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // Loopback only: the endpoint is for local scrapers, not clients
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(admin_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(admin_socket, 16) < 0) {
+        LOG_ERROR("Failed to set up admin port: %m");
+        close(admin_socket);
+        admin_socket = -1;
+        return -1;
+    }
+
+    if (pthread_create(&admin_thread, NULL, admin_run, NULL) != 0) {
+        LOG_ERROR("pthread_create failed: %m");
+        close(admin_socket);
+        admin_socket = -1;
+        return -1;
+    }
+    admin_running = 1;
+
+    LOG_INFO("Metrics available at http://127.0.0.1:%d/metrics", port);
+    return 0;
+}
+
+void metrics_stop() {
+    if (!admin_running) return;
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    // Wakes the blocked accept()
+    shutdown(admin_socket, SHUT_RDWR);
+    pthread_join(admin_thread, NULL);
+    close(admin_socket);
+    admin_socket = -1;
+    admin_running = 0;
+}
@@ -0,0 +1,103 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Server metrics. Every thread that records metrics registers once and
+// then writes only to its own slot, with plain (relaxed) stores and no
+// shared cache lines. The admin endpoint sums the slots when scraped and
+// serves them in the Prometheus text format.
+
+#define METRICS_MESSAGE_TYPES 17 // Covers every message_type_t value
+
+typedef enum {
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_FRAMES_OUT,
+    METRIC_FRAMES_DROPPED,      // Discarded by the slow-consumer policy
+    METRIC_CONNECTIONS_OPENED,
+    METRIC_CONNECTIONS_CLOSED,
+    METRIC_SLOW_DISCONNECTS,
+    METRIC_FANOUT_DELIVERIES,   // Recipients reached by broadcasts
+    METRIC_TIMEOUT_DISCONNECTS, // Idle clients and missed login deadlines
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+// Up/down values owned by one thread; the scrape sums them across threads
+typedef enum {
+    METRIC_QUEUED_BYTES,        // Bytes waiting in outbound queues
+    METRIC_PRE_AUTH_CONNECTIONS, // Open connections not logged in yet
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+typedef enum {
+    METRIC_DISPATCH_SECONDS,    // Handling one inbound frame
+    METRIC_FANOUT_SECONDS,      // One group broadcast
+    METRIC_AUTH_SECONDS,        // Login/register from submit to completion
+    METRIC_HISTOGRAM_COUNT
+} metric_histogram_t;
+
+// Log-linear (HDR-style) buckets: four per power of two from 1us up to
+// about 17s, so any value is recorded within 25% of its true size. The
+// first bucket takes everything under 1us and the last everything over 17s.
+#define METRICS_HISTOGRAM_MIN_SHIFT 10
+#define METRICS_HISTOGRAM_MAX_SHIFT 34
+#define METRICS_HISTOGRAM_SUB_BUCKETS 4
+#define METRICS_HISTOGRAM_BUCKETS \
+    (2 + (METRICS_HISTOGRAM_MAX_SHIFT - METRICS_HISTOGRAM_MIN_SHIFT) * METRICS_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+} metrics_histogram_t;
+
+typedef struct {
+    uint64_t messages[METRICS_MESSAGE_TYPES];
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    int64_t gauges[METRIC_GAUGE_COUNT];
+    metrics_histogram_t histograms[METRIC_HISTOGRAM_COUNT];
+} __attribute__((aligned(64))) metrics_slot_t;
+
+extern __thread metrics_slot_t *metrics_local;
+
+// Give the calling thread its own slot; threads that never register record nothing
+void metrics_register_thread();
+
+// Serve /metrics on 127.0.0.1:port from a background thread
+int metrics_start(int port);
+void metrics_stop();
+
+// Hot-path recording. Each slot has a single writer, so a relaxed
+// load/store pair is enough and no locked instruction is needed.
+static inline void metrics_relaxed_add(uint64_t *value, uint64_t n) {
+    __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_count(metric_counter_t counter, uint64_t n) {
+    if (metrics_local) metrics_relaxed_add(&metrics_local->counters[counter], n);
+}
+
+static inline void metrics_count_message(int type) {
+    if (metrics_local && type >= 0 && type < METRICS_MESSAGE_TYPES) {
+        metrics_relaxed_add(&metrics_local->messages[type], 1);
+    }
+}
+
+static inline void metrics_gauge_add(metric_gauge_t gauge, int64_t delta) {
+    if (metrics_local) {
+        int64_t *value = &metrics_local->gauges[gauge];
+        __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+    }
+}
+
+static inline uint64_t metrics_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void metrics_observe(metric_histogram_t histogram, uint64_t ns);
+
+#endif // SERVER_METRICS_H
@@ -0,0 +1,23 @@
+#ifndef SERVER_MPSC_H
+#define SERVER_MPSC_H
+
+// Lock-free intrusive multi-producer/single-consumer queue (Vyukov).
+// Any thread may push; only the owning thread may pop. Embed an
+// mpsc_node_t as the first member of the queued structure.
+typedef struct mpsc_node {
+    struct mpsc_node *next;
+} mpsc_node_t;
+
+typedef struct {
+    mpsc_node_t *head; // Producers swap themselves in here
+    mpsc_node_t *tail; // Consumer reads from here
+    mpsc_node_t stub;
+} mpsc_queue_t;
+
+void mpsc_init(mpsc_queue_t *queue);
+void mpsc_push(mpsc_queue_t *queue, mpsc_node_t *node);
+// Returns NULL when empty, or when a producer is mid-push; in that case
+// the producer's wakeup makes the consumer try again
+mpsc_node_t* mpsc_pop(mpsc_queue_t *queue);
+
+#endif // SERVER_MPSC_H
@@ -1,5 +1,15 @@
 #include "network.h"
 #include "auth.h"
+#include "connection.h"
+#include "registry.h"
+#include "shard.h"
+#include "auth_worker.h"
+#include "metrics.h"
+#include "history.h"
+#include "catchup.h"
+#include "logger.h"
+#include "../common/frame.h"
+#include "../common/codec.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,18 +19,27 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <signal.h>
+#include <fcntl.h>
 
 int setup_server_socket(const char *ip, int port) {
     int server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket == -1) {
-        perror("Failed to create socket");
+        LOG_ERROR("Failed to create socket: %m");
         return -1;
     }
     
     // Set socket options to reuse address
     int opt = 1;
     if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        perror("setsockopt failed");
+        LOG_ERROR("setsockopt failed: %m");
+        close(server_socket);
+        return -1;
+    }
+    
+    // Each reactor thread binds its own socket to the same port; the kernel
+    // balances incoming connections between them
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        LOG_ERROR("setsockopt SO_REUSEPORT failed: %m");
         close(server_socket);
         return -1;
     }
@@ -37,58 +56,101 @@ int setup_server_socket(const char *ip, int port) {
     }
     
     if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Bind failed");
+        LOG_ERROR("Bind failed: %m");
         close(server_socket);
         return -1;
     }
     
-    if (listen(server_socket, 10) < 0) {
-        perror("Listen failed");
+    if (listen(server_socket, SOMAXCONN) < 0) {
+        LOG_ERROR("Listen failed: %m");
         close(server_socket);
         return -1;
     }
     
-    printf("Server listening on %s:%d\n", ip, port);
+    LOG_INFO("Server listening on %s:%d", ip, port);
     return server_socket;
 }
 
+int set_socket_nonblocking(int socket_fd) {
+    int flags = fcntl(socket_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_ERROR("fcntl O_NONBLOCK failed: %m");
+        return -1;
+    }
+    return 0;
+}
+
 int accept_client_connection(int server_socket) {
     struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
     
     int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
     if (client_socket < 0) {
-        perror("Accept failed");
+        // The listening socket is non-blocking; EAGAIN means the backlog is drained
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("Accept failed: %m");
+        }
+        return -1;
+    }
+    
+    if (set_socket_nonblocking(client_socket) < 0) {
+        close(client_socket);
         return -1;
     }
     
     char client_ip[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-    printf("New client connected from %s:%d\n", client_ip, ntohs(client_addr.sin_port));
+    LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "New client connected from %s:%d", client_ip, ntohs(client_addr.sin_port));
     
     return client_socket;
 }
 
-int receive_message(int client_socket, message_t *message) {
-    int bytes_received = recv(client_socket, message, sizeof(message_t), 0);
-    if (bytes_received <= 0) {
-        if (bytes_received == 0) {
-            printf("Client disconnected\n");
-        } else {
-            perror("Recv failed");
-        }
+int send_message(int client_socket, const message_t *message) {
+    uint8_t frame[MAX_FRAME_LEN];
+    size_t frame_len = frame_encode(message, frame);
+    
+    // Never blocks: whatever the socket does not take now is queued on the connection
+    if (connection_send(connection_lookup(client_socket), frame, frame_len) < 0) {
         return -1;
     }
-    return bytes_received;
+    return (int)frame_len;
 }
 
-int send_message(int client_socket, const message_t *message) {
-    int bytes_sent = send(client_socket, message, sizeof(message_t), 0);
-    if (bytes_sent < 0) {
-        perror("Send failed");
-        return -1;
-    }
-    return bytes_sent;
+// Responses are sent trimmed to the end of their text
+static void send_response(int client_socket, message_type_t type, uint32_t request_id,
+                          const response_message_t *response) {
+    message_t response_msg;
+    response_msg.type = type;
+    response_msg.request_id = request_id;
+    response_msg.length = response_encode(response, (uint8_t*)response_msg.data);
+    
+    send_message(client_socket, &response_msg);
+}
+
+// Group responses name the group by ID as well, for the chat that follows
+static void send_group_response(int client_socket, uint32_t request_id, const group_response_t *response) {
+    message_t response_msg;
+    response_msg.type = MSG_GROUP_RESPONSE;
+    response_msg.request_id = request_id;
+    response_msg.length = group_response_encode(response, (uint8_t*)response_msg.data);
+    
+    send_message(client_socket, &response_msg);
+}
+
+static void send_history_response(int client_socket, uint32_t request_id, const history_response_t *response) {
+    message_t response_msg;
+    response_msg.type = MSG_HISTORY_RESPONSE;
+    response_msg.request_id = request_id;
+    response_msg.length = history_response_encode(response, (uint8_t*)response_msg.data);
+    
+    send_message(client_socket, &response_msg);
+}
+
+static void group_response_init(group_response_t *response, const char *group_name) {
+    response->success = 0;
+    response->group_id = INVALID_ID;
+    memset(response->group_name, 0, MAX_GROUP_NAME_LEN);
+    strncpy(response->group_name, group_name, MAX_GROUP_NAME_LEN - 1);
 }
 
 void add_client(int client_socket, list_t *users) {
@@ -96,58 +158,274 @@ void add_client(int client_socket, list_t *users) {
     // The actual user will be added when they log in
 }
 
-void remove_client(int client_socket, list_t *users) {
-    user_list_remove_by_socket(users, client_socket);
+void remove_client(int client_socket, list_t *users, list_t *groups) {
+    user_t *user = user_list_find_by_socket(users, client_socket);
+    if (user) {
+        // Drop the user from the fan-out sets of every group they belong to.
+        // The record and its memberships stay, with delivery cursors, so the
+        // next login can pick up where this one left off.
+        for (uint32_t i = 0; i < user->groups.count; i++) {
+            remove_online_member(group_list_find_by_id(groups, user->groups.ids[i]), user);
+        }
+        catchup_save_cursors(user, groups, connection_lookup(client_socket));
+        user->is_online = 0;
+        user_list_set_socket(users, user, -1);
+    }
     close(client_socket);
 }
 
 void broadcast_to_all_clients(const message_t *message, list_t *users) {
+    uint8_t buf[MAX_FRAME_LEN];
+    shared_frame_t *frame = shared_frame_create(buf, frame_encode(message, buf));
+    if (!frame) return;
+    
+    shard_fanout_begin(frame);
     list_node_t *current = users->head;
     while (current) {
         user_t *user = (user_t*)current->data;
         if (user->is_online) {
-            send_message(user->socket_fd, message);
+            shard_fanout_add(user);
         }
         current = current->next;
     }
+    shard_fanout_end();
+    shared_frame_release(frame);
+}
+
+// Answers a request that needs a login without going near the registry
+static void reject_unauthenticated(int client_socket, const message_t *message) {
+    switch (message->type) {
+        case MSG_JOIN_GROUP:
+        case MSG_CREATE_GROUP:
+        case MSG_LEAVE_GROUP: {
+            group_response_t response;
+            group_response_init(&response, ((group_message_t*)message->data)->group_name);
+            strcpy(response.message, "User not authenticated");
+            send_group_response(client_socket, message->request_id, &response);
+            break;
+        }
+        case MSG_HISTORY_REQUEST: {
+            history_request_t request;
+            history_response_t response;
+            memset(&response, 0, sizeof(response));
+            if (history_request_decode((const uint8_t*)message->data, message->length, &request) == 0) {
+                memcpy(response.group_name, request.group_name, MAX_GROUP_NAME_LEN);
+            }
+            send_history_response(client_socket, message->request_id, &response);
+            break;
+        }
+        default:
+            break; // Chat from a stranger is dropped, as before
+    }
 }
 
-void handle_client_message(int client_socket, message_t *message, list_t *users, list_t *groups) {
+int handle_client_message(int client_socket, message_t *message, list_t *users, list_t *groups) {
+    if (connection_lookup(client_socket)->state == CONN_PRE_AUTH &&
+        message->type != MSG_LOGIN && message->type != MSG_REGISTER && message->type != MSG_LOGOUT &&
+        message->type != MSG_PING && message->type != MSG_PONG) {
+        reject_unauthenticated(client_socket, message);
+        return 0;
+    }
+    
+    // Users and groups are shared by all reactor threads: chat only reads
+    // them, everything else that touches them changes them
     switch (message->type) {
         case MSG_LOGIN:
-            process_login_message(client_socket, message, users);
+            process_login_message(client_socket, message, users, groups);
             break;
         case MSG_REGISTER:
-            process_register_message(client_socket, message, users);
+            process_register_message(client_socket, message, users, groups);
             break;
         case MSG_JOIN_GROUP:
+            registry_write_lock();
             process_join_group_message(client_socket, message, users, groups);
+            registry_unlock();
             break;
         case MSG_CREATE_GROUP:
+            registry_write_lock();
             process_create_group_message(client_socket, message, users, groups);
+            registry_unlock();
             break;
         case MSG_CHAT_MESSAGE:
+            registry_read_lock();
             process_chat_message(client_socket, message, users, groups);
+            registry_unlock();
+            break;
+        case MSG_HISTORY_REQUEST:
+            registry_read_lock();
+            process_history_request(client_socket, message, users, groups);
+            registry_unlock();
             break;
         case MSG_LEAVE_GROUP:
+            registry_write_lock();
             process_leave_group_message(client_socket, message, users, groups);
+            registry_unlock();
             break;
         case MSG_LOGOUT:
-            remove_client(client_socket, users);
+            return -1; // The caller closes the connection
+        case MSG_PING: {
+            message_t pong;
+            pong.type = MSG_PONG;
+            pong.request_id = message->request_id;
+            pong.length = 0;
+            send_message(client_socket, &pong);
             break;
+        }
+        case MSG_PONG:
+            break; // Reading it already counted as activity
         default:
-            printf("Unknown message type: %d\n", message->type);
+            LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Unknown message type: %d", message->type);
             break;
     }
+    return 0;
+}
+
+int handle_client_input(int client_socket, frame_buffer_t *buffer, list_t *users, list_t *groups) {
+    connection_t *conn = connection_lookup(client_socket);
+    
+    // Edge-triggered: read until the socket is drained, dispatching every
+    // complete frame each read brings in. While an auth job is out, frames
+    // stay buffered (and unread data stays in the socket) so requests are
+    // still handled in order; the job's completion resumes from here.
+    while (1) {
+        message_t message;
+        int status = 0;
+        while (!conn->auth_pending && (status = frame_buffer_next(buffer, &message)) > 0) {
+            uint64_t started = metrics_now();
+            metrics_count_message(message.type);
+            int result = handle_client_message(client_socket, &message, users, groups);
+            metrics_observe(METRIC_DISPATCH_SECONDS, metrics_now() - started);
+            if (result < 0) {
+                return -1;
+            }
+        }
+        if (status < 0) {
+            LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Invalid frame from socket %d", client_socket);
+            return -1;
+        }
+        if (conn->auth_pending) {
+            return 0;
+        }
+        
+        int bytes_received = frame_buffer_fill(buffer, client_socket);
+        if (bytes_received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Recv failed: %m");
+            return -1;
+        }
+        if (bytes_received == 0) {
+            LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "Client disconnected");
+            return -1;
+        }
+        metrics_count(METRIC_BYTES_IN, bytes_received);
+        connection_touch(conn);
+    }
 }
 
-void process_login_message(int client_socket, const message_t *message, list_t *users) {
+// Runs on the connection's shard once a worker has checked or stored the password
+static void complete_auth_job(shard_task_t *task) {
+    auth_job_t *job = (auth_job_t*)task;
+    metrics_observe(METRIC_AUTH_SECONDS, metrics_now() - job->submitted_ns);
+    
+    connection_t *conn = connection_lookup(job->client_socket);
+    if (conn && conn->id == job->conn_id && !conn->closing) {
+        conn->auth_pending = 0;
+        
+        if (job->type == AUTH_JOB_LOGIN) {
+            registry_write_lock();
+            finish_login(job->client_socket, job->request_id, job->username, job->success,
+                         job->users, job->groups);
+            registry_unlock();
+        } else {
+            finish_register(job->client_socket, job->request_id, job->username, job->success);
+        }
+        
+        // Catch up on requests that arrived while the job ran
+        if (handle_client_input(job->client_socket, conn->rx, job->users, job->groups) < 0) {
+            LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "Client on socket %d disconnected", job->client_socket);
+            connection_schedule_close(conn);
+        }
+    }
+    free(job);
+}
+
+// Hand the password work to the auth workers; the response is sent on completion
+static void submit_auth_job(int client_socket, auth_job_type_t type, const message_t *message,
+                            list_t *users, list_t *groups) {
     auth_message_t *auth_msg = (auth_message_t*)message->data;
+    connection_t *conn = connection_lookup(client_socket);
+    
+    auth_job_t *job = malloc(sizeof(auth_job_t));
+    if (job) {
+        job->task.run = complete_auth_job;
+        job->type = type;
+        job->shard = shard_current_id();
+        job->client_socket = client_socket;
+        job->conn_id = conn->id;
+        job->request_id = message->request_id;
+        job->users = users;
+        job->groups = groups;
+        strncpy(job->username, auth_msg->username, MAX_USERNAME_LEN - 1);
+        job->username[MAX_USERNAME_LEN - 1] = '\0';
+        strncpy(job->password, auth_msg->password, MAX_PASSWORD_LEN - 1);
+        job->password[MAX_PASSWORD_LEN - 1] = '\0';
+        job->success = 0;
+        job->submitted_ns = metrics_now();
+    }
+    
+    if (!job || auth_submit(job) < 0) {
+        free(job);
+        
+        response_message_t response;
+        response.success = 0;
+        strcpy(response.message, "Server busy, try again");
+        send_response(client_socket, type == AUTH_JOB_LOGIN ? MSG_LOGIN_RESPONSE : MSG_REGISTER_RESPONSE,
+                      message->request_id, &response);
+        return;
+    }
+    conn->auth_pending = 1;
+}
+
+void process_login_message(int client_socket, const message_t *message, list_t *users, list_t *groups) {
+    // One login per connection; no need to hash a password to refuse the second
+    if (connection_lookup(client_socket)->state == CONN_AUTHENTICATED) {
+        response_message_t response;
+        response.success = 0;
+        strcpy(response.message, "Already logged in on this connection");
+        send_response(client_socket, MSG_LOGIN_RESPONSE, message->request_id, &response);
+        return;
+    }
+    submit_auth_job(client_socket, AUTH_JOB_LOGIN, message, users, groups);
+}
+
+// Tells a returning user which groups they are still in, and their IDs
+static void send_memberships(int client_socket, const user_t *user, list_t *groups) {
+    for (uint32_t i = 0; i < user->groups.count; i++) {
+        group_t *group = group_list_find_by_id(groups, user->groups.ids[i]);
+        if (!group) continue;
+        
+        group_response_t response;
+        group_response_init(&response, group->name);
+        response.success = 1;
+        response.group_id = group->id;
+        strcpy(response.message, "Rejoined group");
+        send_group_response(client_socket, 0, &response);
+    }
+}
+
+void finish_login(int client_socket, uint32_t request_id, const char *username, int authenticated,
+                  list_t *users, list_t *groups) {
     response_message_t response;
+    user_t *returning = NULL;
     
-    if (authenticate_user(auth_msg->username, auth_msg->password)) {
+    if (authenticated) {
         // Check if user is already online
-        user_t *existing_user = user_list_find_by_username(users, auth_msg->username);
+        user_t *existing_user = user_list_find_by_username(users, username);
         if (existing_user && existing_user->is_online) {
             response.success = 0;
             strcpy(response.message, "User already logged in");
@@ -156,54 +434,77 @@ void process_login_message(int client_socket, const message_t *message, list_t *
             user_t *user;
             if (existing_user) {
                 user = existing_user;
-                user->socket_fd = client_socket;
+                user_list_set_socket(users, user, client_socket);
                 user->is_online = 1;
             } else {
-                user = create_user(auth_msg->username, client_socket);
-                list_append(users, user);
+                user = create_user(username, client_socket);
+                if (user) {
+                    user_list_add(users, user);
+                }
             }
             
-            response.success = 1;
-            strcpy(response.message, "Login successful");
-            printf("User %s logged in\n", auth_msg->username);
+            if (user) {
+                // Remember where the connection lives for fan-out from other threads
+                connection_t *conn = connection_lookup(client_socket);
+                user->shard = shard_current_id();
+                user->conn_id = conn->id;
+                connection_set_state(conn, CONN_AUTHENTICATED);
+                
+                if (existing_user) {
+                    // Back in the fan-out sets of the groups kept while offline,
+                    // with whatever was missed meanwhile streamed after the response
+                    for (uint32_t i = 0; i < user->groups.count; i++) {
+                        group_t *group = group_list_find_by_id(groups, user->groups.ids[i]);
+                        if (group) {
+                            add_online_member(group, user);
+                        }
+                    }
+                    catchup_start(user, groups, conn);
+                    returning = user;
+                }
+                
+                response.success = 1;
+                strcpy(response.message, "Login successful");
+                LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "User %s logged in", username);
+            } else {
+                response.success = 0;
+                strcpy(response.message, "Login failed");
+            }
         }
     } else {
         response.success = 0;
         strcpy(response.message, "Invalid username or password");
     }
     
-    message_t response_msg;
-    response_msg.type = MSG_LOGIN_RESPONSE;
-    response_msg.length = sizeof(response_message_t);
-    memcpy(response_msg.data, &response, sizeof(response_message_t));
-    
-    send_message(client_socket, &response_msg);
+    send_response(client_socket, MSG_LOGIN_RESPONSE, request_id, &response);
+    if (returning) {
+        send_memberships(client_socket, returning, groups);
+    }
 }
 
-void process_register_message(int client_socket, const message_t *message, list_t *users) {
-    auth_message_t *auth_msg = (auth_message_t*)message->data;
+void process_register_message(int client_socket, const message_t *message, list_t *users, list_t *groups) {
+    submit_auth_job(client_socket, AUTH_JOB_REGISTER, message, users, groups);
+}
+
+void finish_register(int client_socket, uint32_t request_id, const char *username, int registered) {
     response_message_t response;
     
-    if (register_user(auth_msg->username, auth_msg->password)) {
+    if (registered) {
         response.success = 1;
         strcpy(response.message, "Registration successful");
-        printf("New user registered: %s\n", auth_msg->username);
+        LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "New user registered: %s", username);
     } else {
         response.success = 0;
         strcpy(response.message, "Username already exists");
     }
     
-    message_t response_msg;
-    response_msg.type = MSG_REGISTER_RESPONSE;
-    response_msg.length = sizeof(response_message_t);
-    memcpy(response_msg.data, &response, sizeof(response_message_t));
-    
-    send_message(client_socket, &response_msg);
+    send_response(client_socket, MSG_REGISTER_RESPONSE, request_id, &response);
 }
 
 void process_join_group_message(int client_socket, const message_t *message, list_t *users, list_t *groups) {
     group_message_t *group_msg = (group_message_t*)message->data;
-    response_message_t response;
+    group_response_t response;
+    group_response_init(&response, group_msg->group_name);
     
     user_t *user = user_list_find_by_socket(users, client_socket);
     if (!user) {
@@ -215,11 +516,13 @@ void process_join_group_message(int client_socket, const message_t *message, lis
             response.success = 0;
             strcpy(response.message, "Group does not exist");
         } else {
-            if (add_user_to_group(user, group_msg->group_name)) {
-                add_member_to_group(group, user->username);
+            if (add_user_to_group(user, group->id)) {
+                add_member_to_group(group, user->id);
+                add_online_member(group, user);
                 response.success = 1;
+                response.group_id = group->id;
                 strcpy(response.message, "Successfully joined group");
-                printf("User %s joined group %s\n", user->username, group_msg->group_name);
+                LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "User %s joined group %s", user->username, group_msg->group_name);
             } else {
                 response.success = 0;
                 strcpy(response.message, "Failed to join group");
@@ -227,17 +530,13 @@ void process_join_group_message(int client_socket, const message_t *message, lis
         }
     }
     
-    message_t response_msg;
-    response_msg.type = MSG_GROUP_RESPONSE;
-    response_msg.length = sizeof(response_message_t);
-    memcpy(response_msg.data, &response, sizeof(response_message_t));
-    
-    send_message(client_socket, &response_msg);
+    send_group_response(client_socket, message->request_id, &response);
 }
 
 void process_create_group_message(int client_socket, const message_t *message, list_t *users, list_t *groups) {
     group_message_t *group_msg = (group_message_t*)message->data;
-    response_message_t response;
+    group_response_t response;
+    group_response_init(&response, group_msg->group_name);
     
     user_t *user = user_list_find_by_socket(users, client_socket);
     if (!user) {
@@ -252,12 +551,15 @@ void process_create_group_message(int client_socket, const message_t *message, l
         } else {
             group_t *new_group = create_group(group_msg->group_name);
             if (new_group) {
-                list_append(groups, new_group);
-                add_user_to_group(user, group_msg->group_name);
-                add_member_to_group(new_group, user->username);
+                group_list_add(groups, new_group);
+                history_attach(new_group);
+                add_user_to_group(user, new_group->id);
+                add_member_to_group(new_group, user->id);
+                add_online_member(new_group, user);
                 response.success = 1;
+                response.group_id = new_group->id;
                 strcpy(response.message, "Group created successfully");
-                printf("Group %s created by user %s\n", group_msg->group_name, user->username);
+                LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "Group %s created by user %s", group_msg->group_name, user->username);
             } else {
                 response.success = 0;
                 strcpy(response.message, "Failed to create group");
@@ -265,33 +567,101 @@ void process_create_group_message(int client_socket, const message_t *message, l
         }
     }
     
-    message_t response_msg;
-    response_msg.type = MSG_GROUP_RESPONSE;
-    response_msg.length = sizeof(response_message_t);
-    memcpy(response_msg.data, &response, sizeof(response_message_t));
-    
-    send_message(client_socket, &response_msg);
+    send_group_response(client_socket, message->request_id, &response);
 }
 
 void process_chat_message(int client_socket, const message_t *message, list_t *users, list_t *groups) {
-    chat_message_t *chat_msg = (chat_message_t*)message->data;
+    chat_message_t chat_msg;
+    if (chat_decode((const uint8_t*)message->data, message->length, &chat_msg) < 0) {
+        LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Malformed chat message from socket %d", client_socket);
+        return;
+    }
     
     user_t *user = user_list_find_by_socket(users, client_socket);
     if (!user) return;
     
     // Verify user is in the group
-    if (!is_user_in_group(user, group_list_find_by_name(groups, chat_msg->group_name))) {
+    group_t *group = group_list_find_by_id(groups, chat_msg.group_id);
+    if (!group || !is_user_in_group(user, group->id)) {
         return;
     }
     
-    // Broadcast message to group
-    broadcast_message_to_group(chat_msg->group_name, chat_msg->message, user->username, users);
-    printf("Message from %s in group %s: %s\n", user->username, chat_msg->group_name, chat_msg->message);
+    // Broadcast message to group; the sender's name and the time are the server's
+    broadcast_message_to_group(group, chat_msg.message, chat_msg.length, user->username);
+    LOG_SAMPLED(LOG_INFO, LOG_MESSAGE_SAMPLE, "Message from %s in group %s: %s", user->username, group->name, chat_msg.message);
+}
+
+typedef struct {
+    connection_t *conn;
+    uint32_t request_id; // Tags the batch as the answer to this request
+    uint32_t group_id;
+    uint32_t count;
+} history_reply_t;
+
+shared_frame_t* chat_replay_frame(uint32_t request_id, uint32_t group_id, uint64_t seq,
+                                  const uint8_t *record, uint32_t len) {
+    uint8_t prefix[CHAT_PREFIX_MAX_LEN];
+    size_t prefix_len = chat_encode_prefix(group_id, seq, prefix);
+    
+    shared_frame_t *frame = shared_frame_alloc(FRAME_HEADER_LEN + prefix_len + len);
+    if (!frame) return NULL;
+    frame_encode_header(MSG_CHAT_MESSAGE, request_id, prefix_len + len, frame->data);
+    memcpy(frame->data + FRAME_HEADER_LEN, prefix, prefix_len);
+    memcpy(frame->data + FRAME_HEADER_LEN + prefix_len, record, len);
+    return frame;
+}
+
+// Copies one stored message out of the history mapping into its own frame.
+// A frame the slow-consumer policy drops ends the batch there, so the
+// response's next_seq points at it and nothing is skipped.
+static int send_history_message(uint64_t seq, const uint8_t *payload, uint32_t len, void *arg) {
+    history_reply_t *reply = (history_reply_t*)arg;
+    
+    shared_frame_t *frame = chat_replay_frame(reply->request_id, reply->group_id, seq, payload, len);
+    if (!frame) return -1;
+    int result = connection_send_shared(reply->conn, frame);
+    shared_frame_release(frame);
+    if (result < 0) return -1;
+    
+    reply->count++;
+    return 0;
+}
+
+void process_history_request(int client_socket, const message_t *message, list_t *users, list_t *groups) {
+    history_response_t response;
+    memset(&response, 0, sizeof(response));
+    
+    history_request_t request;
+    if (history_request_decode((const uint8_t*)message->data, message->length, &request) < 0) {
+        LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Malformed history request from socket %d", client_socket);
+        send_history_response(client_socket, message->request_id, &response);
+        return;
+    }
+    memcpy(response.group_name, request.group_name, MAX_GROUP_NAME_LEN);
+    
+    // Only members may read a group's history
+    user_t *user = user_list_find_by_socket(users, client_socket);
+    group_t *group = user ? group_list_find_by_name(groups, request.group_name) : NULL;
+    if (group && is_user_in_group(user, group->id)) {
+        response.success = 1;
+        response.next_seq = request.since_seq;
+        if (group->history) {
+            int more;
+            history_reply_t reply = { connection_lookup(client_socket), message->request_id, group->id, 0 };
+            response.next_seq = history_read(group->history, request.since_seq, UINT64_MAX,
+                                           send_history_message, &reply, &more);
+            response.count = reply.count;
+            response.more = more;
+        }
+    }
+    
+    send_history_response(client_socket, message->request_id, &response);
 }
 
 void process_leave_group_message(int client_socket, const message_t *message, list_t *users, list_t *groups) {
     group_message_t *group_msg = (group_message_t*)message->data;
-    response_message_t response;
+    group_response_t response;
+    group_response_init(&response, group_msg->group_name);
     
     user_t *user = user_list_find_by_socket(users, client_socket);
     if (!user) {
@@ -303,11 +673,13 @@ void process_leave_group_message(int client_socket, const message_t *message, li
             response.success = 0;
             strcpy(response.message, "Group does not exist");
         } else {
-            if (remove_user_from_group(user, group_msg->group_name)) {
-                remove_member_from_group(group, user->username);
+            if (remove_user_from_group(user, group->id)) {
+                remove_member_from_group(group, user->id);
+                remove_online_member(group, user);
                 response.success = 1;
+                response.group_id = group->id;
                 strcpy(response.message, "Successfully left group");
-                printf("User %s left group %s\n", user->username, group_msg->group_name);
+                LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "User %s left group %s", user->username, group_msg->group_name);
             } else {
                 response.success = 0;
                 strcpy(response.message, "Failed to leave group");
@@ -315,10 +687,5 @@ void process_leave_group_message(int client_socket, const message_t *message, li
         }
     }
     
-    message_t response_msg;
-    response_msg.type = MSG_GROUP_RESPONSE;
-    response_msg.length = sizeof(response_message_t);
-    memcpy(response_msg.data, &response, sizeof(response_message_t));
-    
-    send_message(client_socket, &response_msg);
+    send_group_response(client_socket, message->request_id, &response);
 }
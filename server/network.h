@@ -3,27 +3,42 @@
 
 #include "../common/protocol.h"
 #include "../common/list.h"
+#include "../common/frame.h"
+#include "connection.h"
 
 // Network setup functions
 int setup_server_socket(const char *ip, int port);
+int set_socket_nonblocking(int socket_fd);
 int accept_client_connection(int server_socket);
 
 // Message handling functions
-int receive_message(int client_socket, message_t *message);
+// Queues the frame on the client's connection; -1 if dropped by backpressure or closing
 int send_message(int client_socket, const message_t *message);
-void handle_client_message(int client_socket, message_t *message, list_t *users, list_t *groups);
+// Both return -1 when the connection should be closed (disconnect, bad frame, logout), 0 otherwise
+int handle_client_message(int client_socket, message_t *message, list_t *users, list_t *groups);
+int handle_client_input(int client_socket, frame_buffer_t *buffer, list_t *users, list_t *groups);
 
 // Client management functions
 void add_client(int client_socket, list_t *users);
-void remove_client(int client_socket, list_t *users);
+void remove_client(int client_socket, list_t *users, list_t *groups);
 void broadcast_to_all_clients(const message_t *message, list_t *users);
+// Rebuilds the chat frame a stored history record was broadcast as; NULL if out of memory
+shared_frame_t* chat_replay_frame(uint32_t request_id, uint32_t group_id, uint64_t seq,
+                                  const uint8_t *record, uint32_t len);
 
 // Message processing functions
-void process_login_message(int client_socket, const message_t *message, list_t *users);
-void process_register_message(int client_socket, const message_t *message, list_t *users);
+// Login and register hand the password check to the auth workers and pause
+// the connection's input; finish_* send the response once the result is back
+void process_login_message(int client_socket, const message_t *message, list_t *users, list_t *groups);
+void process_register_message(int client_socket, const message_t *message, list_t *users, list_t *groups);
+void finish_login(int client_socket, uint32_t request_id, const char *username, int authenticated,
+                  list_t *users, list_t *groups);
+void finish_register(int client_socket, uint32_t request_id, const char *username, int registered);
 void process_join_group_message(int client_socket, const message_t *message, list_t *users, list_t *groups);
 void process_create_group_message(int client_socket, const message_t *message, list_t *users, list_t *groups);
 void process_chat_message(int client_socket, const message_t *message, list_t *users, list_t *groups);
 void process_leave_group_message(int client_socket, const message_t *message, list_t *users, list_t *groups);
+// Replies with a bounded batch of stored messages and a MSG_HISTORY_RESPONSE
+void process_history_request(int client_socket, const message_t *message, list_t *users, list_t *groups);
 
 #endif // SERVER_NETWORK_H
@@ -0,0 +1,252 @@
+#include "password.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/random.h>
+
+#define SHA256_BLOCK_LEN 64
+#define RECORD_PREFIX "pbkdf2$"
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;              // Bytes hashed so far
+    uint8_t block[SHA256_BLOCK_LEN];
+    size_t block_len;
+} sha256_t;
+
+static const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_compress(uint32_t state[8], const uint8_t block[SHA256_BLOCK_LEN]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_init(sha256_t *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+static void sha256_update(sha256_t *ctx, const uint8_t *data, size_t len) {
+    ctx->length += len;
+    while (len > 0) {
+        size_t take = SHA256_BLOCK_LEN - ctx->block_len;
+        if (take > len) take = len;
+
+        memcpy(ctx->block + ctx->block_len, data, take);
+        ctx->block_len += take;
+        data += take;
+        len -= take;
+
+        if (ctx->block_len == SHA256_BLOCK_LEN) {
+            sha256_compress(ctx->state, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+static void sha256_final(sha256_t *ctx, uint8_t digest[PASSWORD_HASH_LEN]) {
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad = 0x80;
+    sha256_update(ctx, &pad, 1);
+
+    pad = 0;
+    while (ctx->block_len != SHA256_BLOCK_LEN - 8) {
+        sha256_update(ctx, &pad, 1);
+    }
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++) {
+        length[i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha256_update(ctx, length, 8);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+// HMAC key schedule: the inner and outer hashes after absorbing the padded key.
+// PBKDF2 reuses them for every iteration instead of rehashing the key.
+typedef struct {
+    sha256_t inner;
+    sha256_t outer;
+} hmac_sha256_t;
+
+static void hmac_init(hmac_sha256_t *hmac, const uint8_t *key, size_t key_len) {
+    uint8_t block[SHA256_BLOCK_LEN];
+    uint8_t key_digest[PASSWORD_HASH_LEN];
+
+    if (key_len > SHA256_BLOCK_LEN) {
+        sha256_t ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, key, key_len);
+        sha256_final(&ctx, key_digest);
+        key = key_digest;
+        key_len = PASSWORD_HASH_LEN;
+    }
+
+    memset(block, 0x36, sizeof(block));
+    for (size_t i = 0; i < key_len; i++) block[i] ^= key[i];
+    sha256_init(&hmac->inner);
+    sha256_update(&hmac->inner, block, sizeof(block));
+
+    memset(block, 0x5c, sizeof(block));
+    for (size_t i = 0; i < key_len; i++) block[i] ^= key[i];
+    sha256_init(&hmac->outer);
+    sha256_update(&hmac->outer, block, sizeof(block));
+}
+
+static void hmac_compute(const hmac_sha256_t *hmac, const uint8_t *data, size_t len,
+                         uint8_t mac[PASSWORD_HASH_LEN]) {
+    sha256_t ctx = hmac->inner;
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, mac);
+
+    ctx = hmac->outer;
+    sha256_update(&ctx, mac, PASSWORD_HASH_LEN);
+    sha256_final(&ctx, mac);
+}
+
+// PBKDF2-HMAC-SHA256 producing a single block, which is all PASSWORD_HASH_LEN needs
+static void pbkdf2(const char *password, const uint8_t *salt, size_t salt_len, unsigned iterations,
+                   uint8_t out[PASSWORD_HASH_LEN]) {
+    hmac_sha256_t hmac;
+    hmac_init(&hmac, (const uint8_t*)password, strlen(password));
+
+    uint8_t first[PASSWORD_SALT_LEN + 4];
+    memcpy(first, salt, salt_len);
+    first[salt_len] = 0;
+    first[salt_len + 1] = 0;
+    first[salt_len + 2] = 0;
+    first[salt_len + 3] = 1; // Block index, big-endian
+
+    uint8_t u[PASSWORD_HASH_LEN];
+    hmac_compute(&hmac, first, salt_len + 4, u);
+    memcpy(out, u, PASSWORD_HASH_LEN);
+
+    for (unsigned i = 1; i < iterations; i++) {
+        hmac_compute(&hmac, u, PASSWORD_HASH_LEN, u);
+        for (int j = 0; j < PASSWORD_HASH_LEN; j++) {
+            out[j] ^= u[j];
+        }
+    }
+}
+
+static void to_hex(const uint8_t *bytes, size_t len, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = digits[bytes[i] >> 4];
+        out[i * 2 + 1] = digits[bytes[i] & 0x0f];
+    }
+    out[len * 2] = '\0';
+}
+
+static int from_hex(const char *hex, size_t len, uint8_t *out) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned value;
+        if (sscanf(hex + i * 2, "%2x", &value) != 1) return -1;
+        out[i] = (uint8_t)value;
+    }
+    return 0;
+}
+
+// Compares without an early exit so timing does not reveal the matching prefix
+static int constant_time_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+int password_hash(const char *password, unsigned iterations, char record[PASSWORD_RECORD_LEN]) {
+    uint8_t salt[PASSWORD_SALT_LEN];
+    if (getrandom(salt, sizeof(salt), 0) != (ssize_t)sizeof(salt)) {
+        LOG_ERROR("getrandom failed: %m");
+        return -1;
+    }
+
+    uint8_t hash[PASSWORD_HASH_LEN];
+    pbkdf2(password, salt, sizeof(salt), iterations, hash);
+
+    char salt_hex[PASSWORD_SALT_LEN * 2 + 1];
+    char hash_hex[PASSWORD_HASH_LEN * 2 + 1];
+    to_hex(salt, sizeof(salt), salt_hex);
+    to_hex(hash, sizeof(hash), hash_hex);
+    snprintf(record, PASSWORD_RECORD_LEN, RECORD_PREFIX "%u$%s$%s", iterations, salt_hex, hash_hex);
+    return 0;
+}
+
+int password_verify(const char *password, const char *record) {
+    if (strncmp(record, RECORD_PREFIX, strlen(RECORD_PREFIX)) != 0) {
+        // Legacy plaintext entry
+        size_t len = strlen(record);
+        return strlen(password) == len && constant_time_equal((const uint8_t*)password,
+                                                              (const uint8_t*)record, len);
+    }
+
+    unsigned iterations;
+    char salt_hex[PASSWORD_SALT_LEN * 2 + 1];
+    char hash_hex[PASSWORD_HASH_LEN * 2 + 1];
+    if (sscanf(record + strlen(RECORD_PREFIX), "%u$%32[0-9a-f]$%64[0-9a-f]",
+               &iterations, salt_hex, hash_hex) != 3 ||
+        iterations == 0 ||
+        strlen(salt_hex) != PASSWORD_SALT_LEN * 2 || strlen(hash_hex) != PASSWORD_HASH_LEN * 2) {
+        return 0;
+    }
+
+    uint8_t salt[PASSWORD_SALT_LEN];
+    uint8_t expected[PASSWORD_HASH_LEN];
+    if (from_hex(salt_hex, sizeof(salt), salt) < 0 || from_hex(hash_hex, sizeof(expected), expected) < 0) {
+        return 0;
+    }
+
+    uint8_t actual[PASSWORD_HASH_LEN];
+    pbkdf2(password, salt, sizeof(salt), iterations, actual);
+    return constant_time_equal(actual, expected, PASSWORD_HASH_LEN);
+}
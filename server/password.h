@@ -0,0 +1,20 @@
+#ifndef SERVER_PASSWORD_H
+#define SERVER_PASSWORD_H
+
+#include <stddef.h>
+
+// Stored form of a password: "pbkdf2$<iterations>$<salt hex>$<hash hex>"
+// (PBKDF2-HMAC-SHA256). Records without the prefix are legacy plaintext
+// entries from older users.dat files and are still accepted.
+#define PASSWORD_RECORD_LEN 160
+#define PASSWORD_SALT_LEN 16
+#define PASSWORD_HASH_LEN 32
+#define DEFAULT_HASH_ITERATIONS 100000
+
+// Deliberately slow; call from an auth worker, never on a reactor thread.
+// Returns 0 on success, -1 if no salt could be generated.
+int password_hash(const char *password, unsigned iterations, char record[PASSWORD_RECORD_LEN]);
+// Returns 1 if password matches the stored record, 0 otherwise
+int password_verify(const char *password, const char *record);
+
+#endif // SERVER_PASSWORD_H
@@ -0,0 +1,71 @@
+#include "reactor.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+reactor_t* reactor_create() {
+    reactor_t *reactor = malloc(sizeof(reactor_t));
+    if (!reactor) return NULL;
+
+    reactor->epoll_fd = epoll_create1(0);
+    if (reactor->epoll_fd < 0) {
+        LOG_ERROR("epoll_create1 failed: %m");
+        free(reactor);
+        return NULL;
+    }
+
+    return reactor;
+}
+
+void reactor_destroy(reactor_t *reactor) {
+    if (!reactor) return;
+
+    if (reactor->epoll_fd >= 0) {
+        close(reactor->epoll_fd);
+    }
+    free(reactor);
+}
+
+int reactor_add(reactor_t *reactor, int fd, uint32_t events, void *data) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = data;
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        LOG_ERROR("epoll_ctl add failed: %m");
+        return -1;
+    }
+    return 0;
+}
+
+int reactor_modify(reactor_t *reactor, int fd, uint32_t events, void *data) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = data;
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0) {
+        LOG_ERROR("epoll_ctl modify failed: %m");
+        return -1;
+    }
+    return 0;
+}
+
+int reactor_remove(reactor_t *reactor, int fd) {
+    // Kernels before 2.6.9 require a non-NULL event even for EPOLL_CTL_DEL
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, &event) < 0) {
+        LOG_ERROR("epoll_ctl remove failed: %m");
+        return -1;
+    }
+    return 0;
+}
+
+int reactor_wait(reactor_t *reactor, int timeout_ms) {
+    return epoll_wait(reactor->epoll_fd, reactor->events, REACTOR_MAX_EVENTS, timeout_ms);
+}
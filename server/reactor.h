@@ -0,0 +1,28 @@
+#ifndef SERVER_REACTOR_H
+#define SERVER_REACTOR_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#define REACTOR_MAX_EVENTS 256
+
+// Edge-triggered epoll reactor. Each registered fd carries an opaque
+// pointer to its per-connection state, set once at registration time.
+typedef struct {
+    int epoll_fd;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+} reactor_t;
+
+// Reactor lifecycle
+reactor_t* reactor_create();
+void reactor_destroy(reactor_t *reactor);
+
+// Registration functions
+int reactor_add(reactor_t *reactor, int fd, uint32_t events, void *data);
+int reactor_modify(reactor_t *reactor, int fd, uint32_t events, void *data);
+int reactor_remove(reactor_t *reactor, int fd);
+
+// Wait for readiness; returns the number of entries filled in reactor->events
+int reactor_wait(reactor_t *reactor, int timeout_ms);
+
+#endif // SERVER_REACTOR_H
@@ -0,0 +1,30 @@
+#include "registry.h"
+#include <pthread.h>
+
+static pthread_rwlock_t registry_lock;
+
+int registry_init() {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+
+    int result = pthread_rwlock_init(&registry_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    return result == 0 ? 0 : -1;
+}
+
+void registry_destroy() {
+    pthread_rwlock_destroy(&registry_lock);
+}
+
+void registry_read_lock() {
+    pthread_rwlock_rdlock(&registry_lock);
+}
+
+void registry_write_lock() {
+    pthread_rwlock_wrlock(&registry_lock);
+}
+
+void registry_unlock() {
+    pthread_rwlock_unlock(&registry_lock);
+}
@@ -0,0 +1,16 @@
+#ifndef SERVER_REGISTRY_H
+#define SERVER_REGISTRY_H
+
+// Lock over the shared server state touched by every reactor thread: the
+// user and group lists, group membership and the name tables. Chat fan-out
+// only reads that state and takes the lock shared; login, logout and group
+// changes take it exclusively. Writers are preferred so a steady chat load
+// cannot starve logins.
+int registry_init();
+void registry_destroy();
+
+void registry_read_lock();
+void registry_write_lock();
+void registry_unlock();
+
+#endif // SERVER_REGISTRY_H
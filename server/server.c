@@ -3,149 +3,152 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
-#include <sys/select.h>
+#include <pthread.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include "network.h"
 #include "auth.h"
+#include "config.h"
+#include "registry.h"
+#include "shard.h"
+#include "auth_worker.h"
+#include "metrics.h"
+#include "logger.h"
+#include "history.h"
+#include "catchup.h"
 #include "../common/list.h"
 
 #define MAX_CLIENTS 100
 #define BUFFER_SIZE 1024
+#define USERS_FILE "users.dat"
 
-static int server_socket = -1;
 static list_t *users = NULL;
 static list_t *groups = NULL;
 
-void cleanup() {
-    printf("\nShutting down server...\n");
+// How far startup got, so teardown only undoes what was set up
+static int registry_ready = 0;
+static int threads_started = 0;
+
+// Tear down and return the exit status to leave with
+static int cleanup(int status) {
+    LOG_INFO("Shutting down server...");
     
+    // Workers post results to the shards, so they stop first; then join the
+    // reactor threads before freeing what they share
+    if (threads_started) {
+        metrics_stop();
+        auth_workers_stop();
+        shards_stop();
+    }
     if (users) {
         user_list_destroy(users);
     }
     if (groups) {
+        history_close(groups);
         group_list_destroy(groups);
     }
-    if (server_socket != -1) {
-        close(server_socket);
+    catchup_cleanup();
+    auth_cleanup();
+    if (registry_ready) {
+        registry_destroy();
     }
+    pool_destroy(&user_pool);
+    pool_destroy(&group_pool);
+    pool_destroy(&list_node_pool);
+    log_shutdown();
     
-    exit(0);
+    return status;
 }
 
-void signal_handler(int sig) {
-    cleanup();
+// Allow as many open sockets as the hard limit permits
+static void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            LOG_ERROR("setrlimit failed: %m");
+        }
+    }
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <server_ip> <port_number>\n", argv[0]);
-        printf("Example: %s 0.0.0.0 8080\n", argv[0]);
+    if (parse_server_config(argc, argv, &server_config) < 0) {
+        print_server_usage(argv[0]);
         return 1;
     }
     
-    char *server_ip = argv[1];
-    int port = atoi(argv[2]);
+    const char *server_ip = server_config.ip;
+    int port = server_config.port;
     
-    if (port <= 0 || port > 65535) {
-        printf("Invalid port number. Must be between 1 and 65535.\n");
+    // Shutdown signals are taken synchronously by the main thread. Block them
+    // before any reactor thread starts so every thread inherits the mask.
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    // Started after the mask so the writer thread never takes a signal
+    if (log_init(server_config.log_level) < 0) {
         return 1;
     }
     
-    // Set up signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    raise_fd_limit();
     
-    // Initialize data structures
+    // Initialize data structures. Every user and group sits on one list, so
+    // the list node pool needs room for both. Each shard gets its own cache
+    // of every pool so its allocations skip the pool lock.
+    if (pool_reserve(&user_pool, server_config.pool_size) < 0 ||
+        pool_reserve(&group_pool, server_config.pool_size) < 0 ||
+        pool_reserve(&list_node_pool, 2 * (size_t)server_config.pool_size) < 0 ||
+        pool_set_caches(&user_pool, server_config.threads) < 0 ||
+        pool_set_caches(&group_pool, server_config.threads) < 0 ||
+        pool_set_caches(&list_node_pool, server_config.threads) < 0) {
+        LOG_ERROR("Failed to preallocate object pools");
+        return cleanup(1);
+    }
     users = user_list_create();
     groups = group_list_create();
     
     if (!users || !groups) {
-        printf("Failed to initialize data structures\n");
-        cleanup();
-        return 1;
+        LOG_ERROR("Failed to initialize data structures");
+        return cleanup(1);
+    }
+    if (registry_init() < 0) {
+        LOG_ERROR("Failed to initialize the registry lock");
+        return cleanup(1);
+    }
+    registry_ready = 1;
+    if (auth_init(USERS_FILE) < 0 || history_open(server_config.history_dir, groups) < 0) {
+        LOG_ERROR("Failed to initialize data structures");
+        return cleanup(1);
     }
     
-    // Set up server socket
-    server_socket = setup_server_socket(server_ip, port);
-    if (server_socket == -1) {
-        printf("Failed to set up server socket\n");
-        cleanup();
-        return 1;
+    // Start the reactor threads, each with its own listening socket, and the
+    // workers that take password hashing off them. Each stop function only
+    // joins the threads that did start.
+    threads_started = 1;
+    if (shards_start(server_config.threads, server_ip, port, users, groups) < 0 ||
+        auth_workers_start(server_config.auth_threads) < 0) {
+        LOG_ERROR("Failed to start server threads");
+        return cleanup(1);
     }
     
-    printf("TCP Group Chat Server started successfully!\n");
-    printf("Server IP: %s, Port: %d\n", server_ip, port);
-    printf("Press Ctrl+C to stop the server\n\n");
+    if (server_config.admin_port && metrics_start(server_config.admin_port) < 0) {
+        LOG_ERROR("Failed to start metrics endpoint");
+        return cleanup(1);
+    }
     
-    fd_set read_fds;
-    int max_fd = server_socket;
+    LOG_INFO("TCP Group Chat Server started successfully!");
+    LOG_INFO("Server IP: %s, Port: %d, Threads: %d", server_ip, port, server_config.threads);
+    LOG_INFO("Press Ctrl+C to stop the server");
     
-    // Main server loop
-    while (1) {
-        FD_ZERO(&read_fds);
-        FD_SET(server_socket, &read_fds);
-        
-        // Add all client sockets to the set
-        list_node_t *current = users->head;
-        while (current) {
-            user_t *user = (user_t*)current->data;
-            if (user->is_online && user->socket_fd > 0) {
-                FD_SET(user->socket_fd, &read_fds);
-                if (user->socket_fd > max_fd) {
-                    max_fd = user->socket_fd;
-                }
-            }
-            current = current->next;
-        }
-        
-        // Wait for activity on any socket
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-        if (activity < 0) {
-            if (errno == EINTR) {
-                continue; // Interrupted by signal
-            }
-            perror("Select failed");
-            break;
-        }
-        
-        // Check for new connections
-        if (FD_ISSET(server_socket, &read_fds)) {
-            int client_socket = accept_client_connection(server_socket);
-            if (client_socket > 0) {
-                if (client_socket > max_fd) {
-                    max_fd = client_socket;
-                }
-                printf("New client connection accepted (socket: %d)\n", client_socket);
-            }
-        }
-        
-        // Check for data from existing clients
-        current = users->head;
-        while (current) {
-            user_t *user = (user_t*)current->data;
-            list_node_t *next = current->next; // Store next before potential removal
-            
-            if (user->is_online && user->socket_fd > 0 && FD_ISSET(user->socket_fd, &read_fds)) {
-                message_t message;
-                int bytes_received = receive_message(user->socket_fd, &message);
-                
-                if (bytes_received <= 0) {
-                    // Client disconnected
-                    printf("Client %s disconnected\n", user->username);
-                    remove_client(user->socket_fd, users);
-                } else {
-                    // Process the message
-                    handle_client_message(user->socket_fd, &message, users, groups);
-                }
-            }
-            
-            current = next;
-        }
-    }
+    int sig;
+    sigwait(&shutdown_signals, &sig);
     
-    cleanup();
-    return 0;
+    return cleanup(0);
 }
@@ -0,0 +1,418 @@
+#include "shard.h"
+#include "network.h"
+#include "connection.h"
+#include "catchup.h"
+#include "credentials.h"
+#include "registry.h"
+#include "timer.h"
+#include "metrics.h"
+#include "logger.h"
+#include "../common/pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+// A connection on another shard that a posted frame is addressed to
+typedef struct {
+    int fd;
+    uint32_t conn_id; // Guards against the fd having been reused since posting
+} shard_target_t;
+
+// One frame and all its recipients on a single shard
+typedef struct {
+    shard_task_t task; // Must be first
+    shard_target_t *targets;
+    uint32_t target_count;
+    uint32_t target_capacity;
+    shared_frame_t *frame; // Holds a reference until delivered
+} shard_msg_t;
+
+static shard_t *shards = NULL;
+static uint32_t shard_count = 0;
+static uint32_t shards_running = 0;
+static int stopping = 0;
+
+// shards_start waits on this for each thread's per-thread setup
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t init_done = PTHREAD_COND_INITIALIZER;
+
+static __thread shard_t *current_shard = NULL;
+
+// Fan-out in progress on this thread, one pending message per target shard
+static __thread shard_msg_t **fanout_pending = NULL;
+static __thread shared_frame_t *fanout_frame = NULL;
+
+uint32_t shard_current_id() {
+    return current_shard ? current_shard->id : 0;
+}
+
+static void shard_wake(shard_t *shard) {
+    if (__atomic_exchange_n(&shard->wake_pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        uint64_t one = 1;
+        if (write(shard->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            LOG_ERROR("eventfd write failed: %m");
+        }
+    }
+}
+
+void shard_post_task(uint32_t shard_id, shard_task_t *task) {
+    shard_t *shard = &shards[shard_id];
+    mpsc_push(&shard->inbox, &task->node);
+    shard_wake(shard);
+}
+
+static void deliver_frame(shard_task_t *task) {
+    shard_msg_t *msg = (shard_msg_t*)task;
+    for (uint32_t i = 0; i < msg->target_count; i++) {
+        connection_t *conn = connection_lookup(msg->targets[i].fd);
+        if (conn && conn->id == msg->targets[i].conn_id) {
+            connection_send_shared(conn, msg->frame);
+        }
+    }
+    shared_frame_release(msg->frame);
+    free(msg->targets);
+    free(msg);
+}
+
+static void run_tasks(shard_t *shard) {
+    mpsc_node_t *node;
+    while ((node = mpsc_pop(&shard->inbox))) {
+        shard_task_t *task = (shard_task_t*)node;
+        task->run(task);
+    }
+}
+
+static void drain_inbox(shard_t *shard) {
+    // Clear the flag before draining so a post that races with us wakes us again
+    uint64_t count;
+    while (read(shard->wake_fd, &count, sizeof(count)) > 0) {
+    }
+    __atomic_store_n(&shard->wake_pending, 0, __ATOMIC_SEQ_CST);
+
+    run_tasks(shard);
+}
+
+void shard_fanout_begin(shared_frame_t *frame) {
+    fanout_frame = frame;
+}
+
+static int add_target(shard_msg_t **pending, const user_t *user) {
+    shard_msg_t *msg = *pending;
+    if (!msg) {
+        msg = malloc(sizeof(shard_msg_t));
+        if (!msg) return -1;
+
+        msg->task.run = deliver_frame;
+        msg->targets = NULL;
+        msg->target_count = 0;
+        msg->target_capacity = 0;
+        msg->frame = shared_frame_retain(fanout_frame);
+        *pending = msg;
+    }
+
+    if (msg->target_count == msg->target_capacity) {
+        uint32_t capacity = msg->target_capacity ? msg->target_capacity * 2 : 8;
+        shard_target_t *grown = realloc(msg->targets, capacity * sizeof(shard_target_t));
+        if (!grown) return -1;
+
+        msg->targets = grown;
+        msg->target_capacity = capacity;
+    }
+
+    msg->targets[msg->target_count].fd = user->socket_fd;
+    msg->targets[msg->target_count].conn_id = user->conn_id;
+    msg->target_count++;
+    return 0;
+}
+
+void shard_fanout_add(const user_t *user) {
+    if (!current_shard || user->shard == current_shard->id) {
+        connection_t *conn = connection_lookup(user->socket_fd);
+        if (conn && conn->id == user->conn_id) {
+            connection_send_shared(conn, fanout_frame);
+        }
+        return;
+    }
+
+    if (add_target(&fanout_pending[user->shard], user) < 0) {
+        LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Dropping frame for %s: out of memory", user->username);
+    }
+}
+
+void shard_fanout_end() {
+    if (!fanout_pending) return;
+
+    for (uint32_t i = 0; i < shard_count; i++) {
+        if (fanout_pending[i]) {
+            shard_post_task(i, &fanout_pending[i]->task);
+            fanout_pending[i] = NULL;
+        }
+    }
+    fanout_frame = NULL;
+}
+
+static void close_connection(shard_t *shard, connection_t *conn) {
+    reactor_remove(shard->reactor, conn->fd);
+
+    // Only a logged-in connection has anything in the registry to undo
+    if (conn->state == CONN_AUTHENTICATED) {
+        registry_write_lock();
+        remove_client(conn->fd, shard->users, shard->groups);
+        registry_unlock();
+    } else {
+        close(conn->fd);
+    }
+
+    connection_destroy(conn);
+    metrics_count(METRIC_CONNECTIONS_CLOSED, 1);
+}
+
+static void accept_pending_connections(shard_t *shard) {
+    // Edge-triggered: keep accepting until the backlog is empty
+    while (1) {
+        int client_socket = accept_client_connection(shard->listen_fd);
+        if (client_socket < 0) {
+            break;
+        }
+
+        connection_t *conn = connection_create(client_socket);
+        if (!conn) {
+            close(client_socket);
+            continue;
+        }
+
+        // EPOLLOUT is edge-triggered too, so it only fires when a full socket drains
+        if (reactor_add(shard->reactor, client_socket, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, conn) < 0) {
+            connection_destroy(conn);
+            close(client_socket);
+            continue;
+        }
+        metrics_count(METRIC_CONNECTIONS_OPENED, 1);
+        LOG_DEBUG("New client connection accepted (socket: %d, shard: %u)", client_socket, shard->id);
+    }
+}
+
+static void handle_connection_events(shard_t *shard, connection_t *conn, uint32_t events) {
+    if (conn->closing) {
+        return;
+    }
+
+    if (events & EPOLLERR) {
+        LOG_RATE_LIMITED(LOG_WARN, LOG_EVENT_RATE, "Client socket %d error", conn->fd);
+        connection_schedule_close(conn);
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        connection_flush(conn);
+    }
+
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+        if (!conn->rx) {
+            conn->rx = malloc(sizeof(frame_buffer_t));
+            if (!conn->rx) {
+                connection_schedule_close(conn);
+                return;
+            }
+            frame_buffer_init(conn->rx);
+        }
+
+        if (handle_client_input(conn->fd, conn->rx, shard->users, shard->groups) < 0) {
+            LOG_RATE_LIMITED(LOG_INFO, LOG_EVENT_RATE, "Client on socket %d disconnected", conn->fd);
+            connection_schedule_close(conn);
+        }
+    }
+}
+
+static void report_init(shard_t *shard, int status) {
+    pthread_mutex_lock(&init_lock);
+    shard->init_status = status;
+    pthread_cond_broadcast(&init_done);
+    pthread_mutex_unlock(&init_lock);
+}
+
+static void* shard_run(void *arg) {
+    shard_t *shard = (shard_t*)arg;
+    current_shard = shard;
+    metrics_register_thread();
+    pool_thread_cache(shard->id);
+
+    fanout_pending = calloc(shard_count, sizeof(shard_msg_t*));
+    if (!fanout_pending || timer_wheel_init() < 0 || connection_table_init(1024) < 0) {
+        LOG_ERROR("Shard %u failed to initialize", shard->id);
+        free(fanout_pending);
+        timer_wheel_destroy();
+        // Stop the kernel routing connections to a listener nobody accepts on
+        reactor_remove(shard->reactor, shard->listen_fd);
+        close(shard->listen_fd);
+        shard->listen_fd = -1;
+        report_init(shard, -1);
+        return NULL;
+    }
+    report_init(shard, 1);
+
+    int backlog_ready = 0;
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        // Wait for activity; only ready sockets are returned. Wake up in time
+        // for the next connection timer and to make pending registrations
+        // durable, or don't wait at all while a login's backlog can go out.
+        int timeout = 0;
+        if (!backlog_ready) {
+            int sync_timeout = credentials_sync_timeout();
+            timeout = timer_next_timeout();
+            if (timeout < 0 || (sync_timeout >= 0 && sync_timeout < timeout)) {
+                timeout = sync_timeout;
+            }
+        }
+        int ready = reactor_wait(shard->reactor, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("epoll_wait failed: %m");
+            break;
+        }
+
+        // Expired timers first: missed login deadlines, idle clients, pings
+        // due. This also refreshes the clock the input below is stamped with.
+        timer_advance();
+
+        for (int i = 0; i < ready; i++) {
+            void *data = shard->reactor->events[i].data.ptr;
+
+            if (data == &shard->listen_fd) {
+                accept_pending_connections(shard);
+            } else if (data == &shard->wake_fd) {
+                drain_inbox(shard);
+            } else {
+                handle_connection_events(shard, (connection_t*)data, shard->reactor->events[i].events);
+            }
+        }
+
+        // Then a bounded slice of any offline backlog, behind the live traffic
+        catchup_run();
+
+        // One writev per connection for everything queued this iteration;
+        // failed writes join the close list below
+        connection_flush_pending();
+        backlog_ready = catchup_ready();
+
+        // Close connections that failed or were cut off during this iteration
+        connection_t *conn;
+        while ((conn = connection_next_closing())) {
+            close_connection(shard, conn);
+        }
+
+        credentials_sync_if_due();
+    }
+
+    connection_table_destroy();
+    timer_wheel_destroy();
+    free(fanout_pending);
+    fanout_pending = NULL;
+    return NULL;
+}
+
+static int shard_init(shard_t *shard, uint32_t id, const char *ip, int port, list_t *users, list_t *groups) {
+    shard->id = id;
+    shard->users = users;
+    shard->groups = groups;
+    shard->wake_pending = 0;
+    mpsc_init(&shard->inbox);
+
+    shard->reactor = reactor_create();
+    if (!shard->reactor) return -1;
+
+    shard->listen_fd = setup_server_socket(ip, port);
+    if (shard->listen_fd < 0 || set_socket_nonblocking(shard->listen_fd) < 0 ||
+        reactor_add(shard->reactor, shard->listen_fd, EPOLLIN | EPOLLET, &shard->listen_fd) < 0) {
+        return -1;
+    }
+
+    shard->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shard->wake_fd < 0) {
+        LOG_ERROR("eventfd failed: %m");
+        return -1;
+    }
+    if (reactor_add(shard->reactor, shard->wake_fd, EPOLLIN | EPOLLET, &shard->wake_fd) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int shards_start(uint32_t count, const char *ip, int port, list_t *users, list_t *groups) {
+    shards = calloc(count, sizeof(shard_t));
+    if (!shards) return -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        shards[i].listen_fd = -1;
+        shards[i].wake_fd = -1;
+    }
+    shard_count = count;
+
+    // Set up every shard before any thread runs, so fan-out never targets a half-built shard
+    for (uint32_t i = 0; i < count; i++) {
+        if (shard_init(&shards[i], i, ip, port, users, groups) < 0) {
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (pthread_create(&shards[i].thread, NULL, shard_run, &shards[i]) != 0) {
+            LOG_ERROR("pthread_create failed: %m");
+            return -1;
+        }
+        shards_running++;
+    }
+
+    // Only report success once every thread has set itself up
+    int status = 0;
+    pthread_mutex_lock(&init_lock);
+    for (uint32_t i = 0; i < count; i++) {
+        while (shards[i].init_status == 0) {
+            pthread_cond_wait(&init_done, &init_lock);
+        }
+        if (shards[i].init_status < 0) {
+            status = -1;
+        }
+    }
+    pthread_mutex_unlock(&init_lock);
+    return status;
+}
+
+void shards_stop() {
+    if (!shards) return;
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < shards_running; i++) {
+        shard_wake(&shards[i]);
+    }
+    for (uint32_t i = 0; i < shards_running; i++) {
+        pthread_join(shards[i].thread, NULL);
+    }
+
+    for (uint32_t i = 0; i < shard_count; i++) {
+        shard_t *shard = &shards[i];
+
+        // Every thread has exited and no connection is left, so tasks still
+        // in flight find nothing to act on and only free themselves
+        run_tasks(shard);
+        if (shard->listen_fd >= 0) {
+            close(shard->listen_fd);
+        }
+        if (shard->wake_fd >= 0) {
+            close(shard->wake_fd);
+        }
+        if (shard->reactor) {
+            reactor_destroy(shard->reactor);
+        }
+    }
+
+    free(shards);
+    shards = NULL;
+    shard_count = 0;
+    shards_running = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_SHARD_H
+#define SERVER_SHARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "reactor.h"
+#include "mpsc.h"
+#include "connection.h"
+#include "../common/list.h"
+
+#define MAX_SHARDS 256
+
+// Work handed to a shard from another thread; run() is called on the
+// shard's own thread and takes ownership of the task. Embed a shard_task_t
+// as the first member of the posted structure.
+typedef struct shard_task {
+    mpsc_node_t node;
+    void (*run)(struct shard_task *task);
+} shard_task_t;
+
+// One reactor thread and the connections it owns. Every shard has its own
+// SO_REUSEPORT listening socket, so the kernel spreads accepts across
+// shards and a connection stays on the thread that accepted it.
+typedef struct shard {
+    uint32_t id;
+    pthread_t thread;
+    reactor_t *reactor;
+    int listen_fd;
+    int wake_fd;         // eventfd written by other shards after posting to the inbox
+    int wake_pending;    // Set while a wakeup is outstanding, so producers write once
+    int init_status;     // Set by the thread after its own setup: 1 ready, -1 failed
+    mpsc_queue_t inbox;  // shard_task_t posted by other threads
+    list_t *users;
+    list_t *groups;
+} shard_t;
+
+// Start count reactor threads serving ip:port; returns 0 on success, -1 on failure
+int shards_start(uint32_t count, const char *ip, int port, list_t *users, list_t *groups);
+// Stop and join every reactor thread. Safe to call after a failed start.
+void shards_stop();
+
+// Shard of the calling reactor thread
+uint32_t shard_current_id();
+// Queue task to run on the given shard's thread. Lock-free; callable from any thread.
+void shard_post_task(uint32_t shard_id, shard_task_t *task);
+
+// Fan-out of one encoded frame to many users. Between begin and end,
+// recipients owned by the calling shard are sent to directly; the rest are
+// collected per owning shard and posted as a single message to each.
+// Every recipient queues a reference to the frame, never a copy; the
+// caller keeps its own reference and releases it after end.
+void shard_fanout_begin(shared_frame_t *frame);
+void shard_fanout_add(const user_t *user);
+void shard_fanout_end();
+
+#endif // SERVER_SHARD_H
@@ -0,0 +1,157 @@
+#include "timer.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SIZE - 1)
+
+typedef struct {
+    wheel_timer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+    uint64_t current;   // Last tick processed
+    uint64_t now_ms;
+    uint32_t armed;
+} timer_wheel_t;
+
+static __thread timer_wheel_t *wheel = NULL;
+
+static uint64_t clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int timer_wheel_init() {
+    wheel = calloc(1, sizeof(timer_wheel_t));
+    if (!wheel) return -1;
+
+    wheel->now_ms = clock_ms();
+    wheel->current = wheel->now_ms / TIMER_TICK_MS;
+    return 0;
+}
+
+void timer_wheel_destroy() {
+    // Owners cancel (or simply free) their timers; nothing here is allocated per timer
+    free(wheel);
+    wheel = NULL;
+}
+
+uint64_t timer_now() {
+    return wheel->now_ms;
+}
+
+// Slot for a timer relative to the current tick
+static void link_timer(wheel_timer_t *timer) {
+    uint64_t expires = timer->expires > wheel->current ? timer->expires : wheel->current + 1;
+    uint64_t delta = expires - wheel->current;
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))) {
+        // Beyond the top level: park in its furthest slot and re-file when it comes round
+        expires = wheel->current + (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    }
+
+    wheel_timer_t **head = &wheel->slots[level][(expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+    timer->next = *head;
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void unlink_timer(wheel_timer_t *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+void timer_schedule(wheel_timer_t *timer, uint64_t delay_ms) {
+    if (timer->pprev) {
+        unlink_timer(timer);
+    } else {
+        wheel->armed++;
+    }
+
+    // Round up, so a timer never fires early
+    timer->expires = (wheel->now_ms + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    link_timer(timer);
+}
+
+void timer_cancel(wheel_timer_t *timer) {
+    if (!wheel || !timer->pprev) return;
+
+    unlink_timer(timer);
+    wheel->armed--;
+}
+
+int timer_next_timeout() {
+    if (wheel->armed == 0) return -1;
+
+    // The next non-empty level-0 slot, or the next wrap, where higher levels cascade
+    uint64_t ticks = 1;
+    while (ticks < TIMER_WHEEL_SIZE) {
+        uint64_t tick = wheel->current + ticks;
+        if (wheel->slots[0][tick & SLOT_MASK] || (tick & SLOT_MASK) == 0) break;
+        ticks++;
+    }
+
+    uint64_t deadline = (wheel->current + ticks) * TIMER_TICK_MS;
+    return deadline > wheel->now_ms ? (int)(deadline - wheel->now_ms) : 0;
+}
+
+// Move one higher-level slot's timers down to where they now belong
+static void cascade(int level) {
+    uint64_t index = (wheel->current >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+    wheel_timer_t *timer = wheel->slots[level][index];
+    wheel->slots[level][index] = NULL;
+
+    while (timer) {
+        wheel_timer_t *next = timer->next;
+        link_timer(timer);
+        timer = next;
+    }
+}
+
+void timer_advance() {
+    timer_advance_to(clock_ms());
+}
+
+void timer_advance_to(uint64_t now_ms) {
+    wheel->now_ms = now_ms;
+    uint64_t target = wheel->now_ms / TIMER_TICK_MS;
+
+    if (wheel->armed == 0) {
+        wheel->current = target;
+        return;
+    }
+
+    while (wheel->current < target) {
+        wheel->current++;
+
+        // Each wrap of a level pulls the next slot of the level above into it
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if ((wheel->current & ((1ull << (TIMER_WHEEL_BITS * level)) - 1)) != 0) break;
+            cascade(level);
+        }
+
+        // Take timers off the head one at a time, so a handler may cancel
+        // any other timer. Nothing re-armed lands back in this slot.
+        wheel_timer_t **slot = &wheel->slots[0][wheel->current & SLOT_MASK];
+        wheel_timer_t *timer;
+        while ((timer = *slot)) {
+            unlink_timer(timer);
+            if (timer->expires <= wheel->current) {
+                wheel->armed--;
+                timer->fire(timer);
+            } else {
+                // Parked beyond the top level; file it again
+                link_timer(timer);
+            }
+        }
+    }
+}
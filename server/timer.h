@@ -0,0 +1,46 @@
+#ifndef SERVER_TIMER_H
+#define SERVER_TIMER_H
+
+#include <stdint.h>
+
+#define TIMER_TICK_MS 100
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS) // Slots per level
+#define TIMER_WHEEL_LEVELS 4                    // 64^4 ticks: about 19 days
+
+// Hierarchical timing wheel, one per reactor thread. Level 0 has a slot per
+// tick; each level above covers TIMER_WHEEL_SIZE slots of the one below, and
+// its timers move down a level when the lower wheel wraps around. Arming,
+// re-arming and cancelling are O(1); expiry costs O(1) per timer plus at
+// most TIMER_WHEEL_LEVELS - 1 moves.
+//
+// Timers are embedded in their owner and have a resolution of one tick.
+typedef struct wheel_timer {
+    struct wheel_timer *next;
+    struct wheel_timer **pprev;  // NULL while not armed
+    uint64_t expires;            // Tick
+    void (*fire)(struct wheel_timer *timer);
+} wheel_timer_t;
+
+// Per-thread wheel; call init/destroy on the owning thread
+int timer_wheel_init();
+void timer_wheel_destroy();
+
+// Monotonic milliseconds as of the last timer_advance (or init)
+uint64_t timer_now();
+
+// Arm (or re-arm) the timer to fire delay_ms from now. fire runs from
+// timer_advance and may re-arm the timer.
+void timer_schedule(wheel_timer_t *timer, uint64_t delay_ms);
+void timer_cancel(wheel_timer_t *timer);
+
+// Milliseconds the event loop may sleep before calling timer_advance; -1 if
+// no timer is armed
+int timer_next_timeout();
+// Read the clock and fire everything due
+void timer_advance();
+// The same with the clock reading supplied (timer_now() plus elapsed
+// milliseconds); for tests, which cannot wait out the upper levels
+void timer_advance_to(uint64_t now_ms);
+
+#endif // SERVER_TIMER_H
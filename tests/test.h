@@ -0,0 +1,27 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the unit tests, one executable per module. A failed
+// CHECK is reported and the test carries on, so one run lists every broken
+// case; test_finish turns the tally into the exit status.
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+static inline int test_finish(const char *name) {
+    if (test_failures) {
+        printf("%s: %d checks failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // TEST_H
@@ -0,0 +1,199 @@
+#include "test.h"
+#include "../common/codec.h"
+#include <string.h>
+
+// Every strict prefix of a valid payload, and the payload with a byte
+// appended, must be rejected
+#define CHECK_TRUNCATIONS(decode, buf, len, out) do { \
+    for (uint32_t cut = 0; cut < (len); cut++) { \
+        CHECK(decode((buf), cut, (out)) < 0); \
+    } \
+    (buf)[(len)] = 0; \
+    CHECK(decode((buf), (len) + 1, (out)) < 0); \
+} while (0)
+
+static void test_varints() {
+    static const struct {
+        uint64_t value;
+        size_t len;
+    } cases[] = {
+        { 0, 1 }, { 127, 1 }, { 128, 2 }, { 16383, 2 }, { 16384, 3 },
+        { UINT32_MAX, 5 }, { UINT64_MAX, VARINT_MAX_LEN },
+    };
+    uint8_t buf[VARINT_MAX_LEN];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t len = varint_encode(cases[i].value, buf);
+        CHECK(len == cases[i].len);
+
+        const uint8_t *pos = buf;
+        uint64_t value = 0;
+        CHECK(varint_decode(&pos, buf + len, &value) == 0);
+        CHECK(value == cases[i].value);
+        CHECK(pos == buf + len);
+
+        // Running out of bytes leaves the position alone
+        pos = buf;
+        CHECK(varint_decode(&pos, buf + len - 1, &value) < 0);
+        CHECK(pos == buf);
+    }
+
+    // UINT64_MAX with one more bit in its last byte
+    varint_encode(UINT64_MAX, buf);
+    buf[VARINT_MAX_LEN - 1] = 0x03;
+    const uint8_t *pos = buf;
+    uint64_t value;
+    CHECK(varint_decode(&pos, buf + VARINT_MAX_LEN, &value) < 0);
+}
+
+static void fill_chat(chat_message_t *chat_msg, uint32_t group_id, uint64_t seq, const char *username,
+                      const char *text) {
+    memset(chat_msg, 0, sizeof(*chat_msg));
+    chat_msg->group_id = group_id;
+    chat_msg->seq = seq;
+    chat_msg->timestamp = 1700000000;
+    strcpy(chat_msg->username, username);
+    chat_msg->length = strlen(text);
+    memcpy(chat_msg->message, text, chat_msg->length);
+}
+
+static void test_chat_round_trip() {
+    chat_message_t sent;
+    chat_message_t received;
+    uint8_t buf[CHAT_MAX_ENCODED_LEN + 1];
+
+    // What a client sends: seq 0 and no username
+    fill_chat(&sent, 1, 0, "", "hi");
+    size_t len = chat_encode(&sent, buf);
+    CHECK(len == 14);
+    CHECK(len == chat_encoded_len(1, 0, "", 2));
+
+    fill_chat(&sent, 70000, 1ull << 40, "alice", "hello, world");
+    sent.timestamp = -5;
+    len = chat_encode(&sent, buf);
+    CHECK(len == chat_encoded_len(70000, 1ull << 40, "alice", 12));
+    CHECK(chat_decode(buf, len, &received) == 0);
+    CHECK(received.group_id == 70000);
+    CHECK(received.seq == 1ull << 40);
+    CHECK(received.timestamp == -5);
+    CHECK(strcmp(received.username, "alice") == 0);
+    CHECK(received.length == 12 && strcmp(received.message, "hello, world") == 0);
+
+    // The two halves the server writes in place make the same bytes
+    uint8_t halves[CHAT_MAX_ENCODED_LEN];
+    size_t n = chat_encode_prefix(70000, 1ull << 40, halves);
+    n += chat_encode_body(-5, "alice", "hello, world", 12, halves + n);
+    CHECK(n == len && memcmp(halves, buf, len) == 0);
+
+    CHECK_TRUNCATIONS(chat_decode, buf, (uint32_t)len, &received);
+}
+
+// Text bytes are not NUL-terminated on the wire, so embedded NULs survive
+static void test_chat_binary_text() {
+    chat_message_t sent;
+    chat_message_t received;
+    uint8_t buf[CHAT_MAX_ENCODED_LEN];
+    fill_chat(&sent, 2, 3, "bob", "");
+    memcpy(sent.message, "a\0b", 3);
+    sent.length = 3;
+
+    size_t len = chat_encode(&sent, buf);
+    CHECK(chat_decode(buf, len, &received) == 0);
+    CHECK(received.length == 3 && memcmp(received.message, "a\0b", 3) == 0);
+}
+
+// Over-long fields are cut to what chat_message_t holds, and the result
+// still fits CHAT_MAX_ENCODED_LEN
+static void test_chat_limits() {
+    static char text[MAX_MESSAGE_LEN + 100];
+    memset(text, 'x', sizeof(text));
+    char username[MAX_USERNAME_LEN + 8];
+    memset(username, 'u', sizeof(username) - 1);
+    username[sizeof(username) - 1] = '\0';
+
+    uint8_t buf[CHAT_MAX_ENCODED_LEN];
+    size_t n = chat_encode_prefix(UINT32_MAX, UINT64_MAX, buf);
+    CHECK(n == CHAT_PREFIX_MAX_LEN);
+    n += chat_encode_body(0, username, text, sizeof(text), buf + n);
+    CHECK(n <= CHAT_MAX_ENCODED_LEN);
+    CHECK(n == chat_encoded_len(UINT32_MAX, UINT64_MAX, username, sizeof(text)));
+    CHECK(CHAT_MAX_ENCODED_LEN <= MAX_PAYLOAD_LEN);
+
+    chat_message_t received;
+    CHECK(chat_decode(buf, n, &received) == 0);
+    CHECK(received.length == MAX_MESSAGE_LEN - 1);
+    CHECK(strlen(received.username) == MAX_USERNAME_LEN - 1);
+}
+
+static void test_responses() {
+    uint8_t buf[GROUP_RESPONSE_MAX_LEN + 1];
+
+    response_message_t response = { .success = 1 };
+    strcpy(response.message, "Login successful");
+    response_message_t decoded_response;
+    size_t len = response_encode(&response, buf);
+    CHECK(len == 1 + 1 + strlen(response.message));
+    CHECK(response_decode(buf, len, &decoded_response) == 0);
+    CHECK(decoded_response.success == 1);
+    CHECK(strcmp(decoded_response.message, response.message) == 0);
+    CHECK_TRUNCATIONS(response_decode, buf, (uint32_t)len, &decoded_response);
+
+    memset(response.message, 'm', sizeof(response.message));
+    CHECK(response_encode(&response, buf) <= RESPONSE_MAX_LEN);
+
+    group_response_t group = { .success = 0, .group_id = 300 };
+    strcpy(group.group_name, "general");
+    strcpy(group.message, "Not a member");
+    group_response_t decoded_group;
+    len = group_response_encode(&group, buf);
+    CHECK(group_response_decode(buf, len, &decoded_group) == 0);
+    CHECK(decoded_group.success == 0 && decoded_group.group_id == 300);
+    CHECK(strcmp(decoded_group.group_name, "general") == 0);
+    CHECK(strcmp(decoded_group.message, "Not a member") == 0);
+    CHECK_TRUNCATIONS(group_response_decode, buf, (uint32_t)len, &decoded_group);
+
+    group.group_id = UINT32_MAX;
+    memset(group.group_name, 'g', sizeof(group.group_name));
+    memset(group.message, 'm', sizeof(group.message));
+    CHECK(group_response_encode(&group, buf) <= GROUP_RESPONSE_MAX_LEN);
+}
+
+static void test_history_messages() {
+    uint8_t buf[HISTORY_REQUEST_MAX_LEN + HISTORY_RESPONSE_MAX_LEN];
+
+    history_request_t request = { .since_seq = 123456789 };
+    strcpy(request.group_name, "general");
+    history_request_t decoded_request;
+    size_t len = history_request_encode(&request, buf);
+    CHECK(history_request_decode(buf, len, &decoded_request) == 0);
+    CHECK(decoded_request.since_seq == 123456789);
+    CHECK(strcmp(decoded_request.group_name, "general") == 0);
+    CHECK_TRUNCATIONS(history_request_decode, buf, (uint32_t)len, &decoded_request);
+
+    history_response_t response = { .success = 1, .count = 256, .next_seq = 1ull << 33, .more = 1 };
+    strcpy(response.group_name, "general");
+    history_response_t decoded_response;
+    len = history_response_encode(&response, buf);
+    CHECK(history_response_decode(buf, len, &decoded_response) == 0);
+    CHECK(decoded_response.success == 1 && decoded_response.more == 1);
+    CHECK(decoded_response.count == 256 && decoded_response.next_seq == 1ull << 33);
+    CHECK(strcmp(decoded_response.group_name, "general") == 0);
+    CHECK_TRUNCATIONS(history_response_decode, buf, (uint32_t)len, &decoded_response);
+
+    request.since_seq = UINT64_MAX;
+    memset(request.group_name, 'g', sizeof(request.group_name));
+    CHECK(history_request_encode(&request, buf) <= HISTORY_REQUEST_MAX_LEN);
+    response.count = UINT32_MAX;
+    response.next_seq = UINT64_MAX;
+    memset(response.group_name, 'g', sizeof(response.group_name));
+    CHECK(history_response_encode(&response, buf) <= HISTORY_RESPONSE_MAX_LEN);
+}
+
+int main() {
+    test_varints();
+    test_chat_round_trip();
+    test_chat_binary_text();
+    test_chat_limits();
+    test_responses();
+    test_history_messages();
+    return test_finish("codec");
+}
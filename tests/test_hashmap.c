@@ -0,0 +1,138 @@
+#include "test.h"
+#include "../common/hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define KEY_COUNT 2000
+
+static char keys[KEY_COUNT][16];
+
+// Keys whose home slot in a map of the given capacity is home
+static int colliding_keys(uint32_t capacity, uint32_t home, int count, char out[][16]) {
+    int found = 0;
+    for (int i = 0; found < count && i < 1000000; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        if ((hashmap_hash(key) & (capacity - 1)) == home) {
+            strcpy(out[found++], key);
+        }
+    }
+    return found;
+}
+
+static void test_put_get_replace() {
+    hashmap_t *map = hashmap_create(0);
+    int a = 1;
+    int b = 2;
+
+    CHECK(hashmap_get(map, "alice") == NULL);
+    CHECK(hashmap_put(map, "alice", &a) == 1);
+    CHECK(hashmap_get(map, "alice") == &a);
+    CHECK(hashmap_put(map, "alice", &b) == 1);
+    CHECK(hashmap_get(map, "alice") == &b);
+    CHECK(map->count == 1);
+    CHECK(hashmap_remove(map, "alice") == &b);
+    CHECK(hashmap_remove(map, "alice") == NULL);
+    CHECK(map->count == 0);
+    hashmap_destroy(map);
+}
+
+// Removing the head of a probe run must shift the rest back, so every key
+// stays reachable and no slot is left behind as a tombstone. Entries that
+// are already in their home slot stay put, and the shift continues past them.
+static void test_backward_shift() {
+    hashmap_t *map = hashmap_create(16);
+    char run[3][16];
+    char settled[1][16];
+    char displaced[1][16];
+    CHECK(colliding_keys(16, 5, 3, run) == 3);
+    CHECK(colliding_keys(16, 8, 1, settled) == 1);
+    CHECK(colliding_keys(16, 6, 1, displaced) == 1);
+
+    // Slots 5 to 7 hold the run, 8 its own key, and the key homed at 6 ends up in 9
+    for (int i = 0; i < 3; i++) {
+        hashmap_put(map, run[i], run[i]);
+    }
+    hashmap_put(map, settled[0], settled[0]);
+    hashmap_put(map, displaced[0], displaced[0]);
+    CHECK(map->entries[8].key == settled[0]);
+    CHECK(map->entries[9].key == displaced[0]);
+
+    CHECK(hashmap_remove(map, run[0]) == run[0]);
+    CHECK(map->entries[5].key == run[1]);
+    CHECK(map->entries[6].key == run[2]);
+    CHECK(map->entries[7].key == displaced[0]);
+    CHECK(map->entries[8].key == settled[0]);
+    CHECK(map->entries[9].key == NULL);
+    CHECK(hashmap_get(map, run[1]) == run[1]);
+    CHECK(hashmap_get(map, run[2]) == run[2]);
+    CHECK(hashmap_get(map, settled[0]) == settled[0]);
+    CHECK(hashmap_get(map, displaced[0]) == displaced[0]);
+
+    // The displaced key moves back into its home slot
+    CHECK(hashmap_remove(map, run[2]) == run[2]);
+    CHECK(map->entries[6].key == displaced[0]);
+    CHECK(map->entries[7].key == NULL);
+    CHECK(map->count == 3);
+    hashmap_destroy(map);
+}
+
+// A run that wraps past the last slot shifts back across the boundary
+static void test_backward_shift_wraps() {
+    hashmap_t *map = hashmap_create(16);
+    char run[3][16];
+    CHECK(colliding_keys(16, 15, 3, run) == 3);
+
+    for (int i = 0; i < 3; i++) {
+        hashmap_put(map, run[i], run[i]);
+    }
+    CHECK(map->entries[15].key == run[0]);
+    CHECK(map->entries[0].key == run[1]);
+    CHECK(map->entries[1].key == run[2]);
+
+    CHECK(hashmap_remove(map, run[0]) == run[0]);
+    CHECK(map->entries[15].key == run[1]);
+    CHECK(map->entries[0].key == run[2]);
+    CHECK(map->entries[1].key == NULL);
+    CHECK(hashmap_get(map, run[1]) == run[1]);
+    CHECK(hashmap_get(map, run[2]) == run[2]);
+    hashmap_destroy(map);
+}
+
+// Random puts and removes through several grows, checked against a plain array
+static void test_against_reference() {
+    hashmap_t *map = hashmap_create(0);
+    int present[KEY_COUNT] = { 0 };
+    uint32_t count = 0;
+    for (int i = 0; i < KEY_COUNT; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "user%d", i);
+    }
+
+    srand(1);
+    for (int step = 0; step < 50000; step++) {
+        int i = rand() % KEY_COUNT;
+        if (rand() % 3) {
+            count += !present[i];
+            present[i] = 1;
+            CHECK(hashmap_put(map, keys[i], keys[i]) == 1);
+        } else {
+            CHECK(hashmap_remove(map, keys[i]) == (present[i] ? keys[i] : NULL));
+            count -= present[i];
+            present[i] = 0;
+        }
+    }
+
+    CHECK(map->count == count);
+    for (int i = 0; i < KEY_COUNT; i++) {
+        CHECK(hashmap_get(map, keys[i]) == (present[i] ? keys[i] : NULL));
+    }
+    hashmap_destroy(map);
+}
+
+int main() {
+    test_put_get_replace();
+    test_backward_shift();
+    test_backward_shift_wraps();
+    test_against_reference();
+    return test_finish("hashmap");
+}
@@ -0,0 +1,158 @@
+#include "test.h"
+#include "../server/history.h"
+#include "../server/auth.h"
+#include "../server/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MESSAGES 300
+#define END_SEQ (MESSAGES + 1) // Sequence numbers start at 1
+#define GROUP_DIR "67656e6572616c" // "general" in hex
+
+typedef struct {
+    uint64_t seqs[MESSAGES];
+    int count;
+    int mismatched;   // Records out of order or not holding "message <seq>"
+} visited_t;
+
+static int visit(uint64_t seq, const uint8_t *payload, uint32_t len, void *arg) {
+    visited_t *visited = (visited_t*)arg;
+    char expected[32];
+    int expected_len = snprintf(expected, sizeof(expected), "message %llu", (unsigned long long)seq);
+    if (len != (uint32_t)expected_len || memcmp(payload, expected, len) != 0 ||
+        (visited->count > 0 && seq != visited->seqs[visited->count - 1] + 1)) {
+        visited->mismatched++;
+    }
+    visited->seqs[visited->count++] = seq;
+    return 0;
+}
+
+static void append_messages(group_log_t *log, int count) {
+    for (int i = 0; i < count; i++) {
+        char payload[32];
+        uint64_t seq = history_lock(log);
+        int len = snprintf(payload, sizeof(payload), "message %llu", (unsigned long long)seq);
+        history_append(log, payload, len);
+        history_unlock(log);
+    }
+}
+
+static group_t* open_group(const char *dir, list_t *groups) {
+    if (history_open(dir, groups) < 0) return NULL;
+    return group_list_find_by_name(groups, "general");
+}
+
+static void close_groups(list_t *groups) {
+    history_close(groups);
+    group_list_destroy(groups);
+}
+
+static void test_append_and_read(const char *dir) {
+    list_t *groups = group_list_create();
+    CHECK(history_open(dir, groups) == 0);
+    CHECK(groups->size == 0);
+
+    group_t *group = create_group("general");
+    group_list_add(groups, group);
+    CHECK(history_attach(group) == 0);
+    CHECK(group->history != NULL);
+    append_messages(group->history, MESSAGES);
+    CHECK(history_next_seq(group->history) == END_SEQ);
+
+    // A full read stops at the batch limit and says where to go on from
+    visited_t visited = { .count = 0 };
+    int more = 0;
+    uint64_t next = history_read(group->history, 0, END_SEQ, visit, &visited, &more);
+    CHECK(more == 1);
+    CHECK(next == 1 + HISTORY_BATCH_MESSAGES);
+    CHECK(visited.count == HISTORY_BATCH_MESSAGES);
+    next = history_read(group->history, next, END_SEQ, visit, &visited, &more);
+    CHECK(more == 0);
+    CHECK(next == END_SEQ);
+    CHECK(visited.count == MESSAGES && visited.seqs[0] == 1);
+    CHECK(visited.mismatched == 0);
+
+    // A window starting between index entries
+    visited.count = 0;
+    next = history_read(group->history, 100, 110, visit, &visited, &more);
+    CHECK(next == 110);
+    CHECK(visited.count == 10 && visited.seqs[0] == 100 && visited.seqs[9] == 109);
+    close_groups(groups);
+}
+
+// Restart: the group comes back with its messages and carries on numbering
+// from where it stopped. A stray file with a hex name is not a group.
+static void test_recover(const char *dir) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/6869", dir);
+    FILE *stray = fopen(path, "w");
+    CHECK(stray != NULL);
+    if (stray) fclose(stray);
+
+    list_t *groups = group_list_create();
+    group_t *group = open_group(dir, groups);
+    CHECK(group != NULL);
+    CHECK(group_list_find_by_name(groups, "hi") == NULL);
+    if (!group) {
+        close_groups(groups);
+        return;
+    }
+    CHECK(history_next_seq(group->history) == END_SEQ);
+
+    visited_t visited = { .count = 0 };
+    int more = 0;
+    history_read(group->history, END_SEQ - 10, END_SEQ, visit, &visited, &more);
+    CHECK(visited.count == 10 && visited.seqs[0] == END_SEQ - 10);
+    CHECK(visited.mismatched == 0);
+
+    append_messages(group->history, 5);
+    visited.count = 0;
+    history_read(group->history, END_SEQ, END_SEQ + 5, visit, &visited, &more);
+    CHECK(visited.count == 5 && visited.seqs[4] == END_SEQ + 4);
+    CHECK(visited.mismatched == 0);
+    close_groups(groups);
+}
+
+// A segment without this format's header stops startup
+static void test_rejects_foreign_segment(const char *dir) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/" GROUP_DIR "/%020d.log", dir, 1);
+    int fd = open(path, O_WRONLY);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    uint32_t magic = 0;
+    CHECK(pwrite(fd, &magic, sizeof(magic), 0) == sizeof(magic));
+    close(fd);
+
+    list_t *groups = group_list_create();
+    CHECK(history_open(dir, groups) < 0);
+    close_groups(groups);
+}
+
+int main() {
+    char base[] = "/tmp/chat-history-test-XXXXXX";
+    if (!mkdtemp(base) || auth_init(NULL) < 0) {
+        printf("Failed to set up\n");
+        return 1;
+    }
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s/history", base);
+
+    // The foreign segment test logs one expected error
+    log_min_level = LOG_ERROR;
+    test_append_and_read(dir);
+    test_recover(dir);
+    test_rejects_foreign_segment(dir);
+    auth_cleanup();
+
+    char command[300];
+    snprintf(command, sizeof(command), "rm -rf %s", base);
+    if (system(command) != 0) {
+        printf("Failed to remove %s\n", base);
+    }
+    return test_finish("history");
+}
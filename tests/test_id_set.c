@@ -0,0 +1,93 @@
+#include "test.h"
+#include "../common/id_set.h"
+#include <stdlib.h>
+
+#define ID_RANGE 5000
+
+static int is_sorted(const id_set_t *set) {
+    for (uint32_t i = 1; i < set->count; i++) {
+        if (set->ids[i - 1] >= set->ids[i]) return 0;
+    }
+    return 1;
+}
+
+static void test_add_remove_contains() {
+    id_set_t set;
+    id_set_init(&set);
+    CHECK(id_set_contains(&set, 1) == 0);
+    CHECK(id_set_remove(&set, 1) == 0);
+
+    CHECK(id_set_add(&set, 30) == 1);
+    CHECK(id_set_add(&set, 10) == 1);
+    CHECK(id_set_add(&set, 20) == 1);
+    CHECK(id_set_add(&set, 20) == 0);
+    CHECK(set.count == 3);
+    CHECK(set.ids[0] == 10 && set.ids[1] == 20 && set.ids[2] == 30);
+    CHECK(id_set_contains(&set, 20) == 1);
+    CHECK(id_set_contains(&set, 25) == 0);
+
+    CHECK(id_set_remove(&set, 10) == 1);
+    CHECK(id_set_remove(&set, 10) == 0);
+    CHECK(set.ids[0] == 20 && set.ids[1] == 30);
+    id_set_free(&set);
+    CHECK(set.ids == NULL && set.count == 0);
+}
+
+// Well past the old fixed caps; memory follows the membership both ways
+static void test_grows_and_shrinks() {
+    id_set_t set;
+    id_set_init(&set);
+    for (uint32_t id = 1; id <= 10000; id++) {
+        CHECK(id_set_add(&set, id) == 1);
+    }
+    CHECK(set.count == 10000);
+    CHECK(set.capacity >= 10000 && set.capacity < 20000);
+
+    for (uint32_t id = 1; id <= 9990; id++) {
+        id_set_remove(&set, id);
+    }
+    CHECK(set.count == 10);
+    CHECK(set.capacity <= 64);
+    CHECK(id_set_contains(&set, 9995) == 1);
+
+    for (uint32_t id = 9991; id <= 10000; id++) {
+        id_set_remove(&set, id);
+    }
+    CHECK(set.count == 0 && set.capacity == 0 && set.ids == NULL);
+}
+
+// Random adds and removes checked against a plain array
+static void test_against_reference() {
+    static int present[ID_RANGE];
+    id_set_t set;
+    id_set_init(&set);
+    uint32_t count = 0;
+
+    srand(1);
+    for (int step = 0; step < 50000; step++) {
+        uint32_t id = 1 + rand() % (ID_RANGE - 1);
+        if (rand() % 2) {
+            CHECK(id_set_add(&set, id) == !present[id]);
+            count += !present[id];
+            present[id] = 1;
+        } else {
+            CHECK(id_set_remove(&set, id) == present[id]);
+            count -= present[id];
+            present[id] = 0;
+        }
+    }
+
+    CHECK(set.count == count);
+    CHECK(is_sorted(&set));
+    for (uint32_t id = 1; id < ID_RANGE; id++) {
+        CHECK(id_set_contains(&set, id) == present[id]);
+    }
+    id_set_free(&set);
+}
+
+int main() {
+    test_add_remove_contains();
+    test_grows_and_shrinks();
+    test_against_reference();
+    return test_finish("id_set");
+}
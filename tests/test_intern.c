@@ -0,0 +1,50 @@
+#include "test.h"
+#include "../common/intern.h"
+#include <string.h>
+
+static void test_ids_are_dense_and_stable() {
+    intern_table_t *table = intern_table_create();
+
+    CHECK(intern_lookup(table, "alice") == INVALID_ID);
+    uint32_t alice = intern(table, "alice");
+    uint32_t bob = intern(table, "bob");
+    CHECK(alice == 1);
+    CHECK(bob == 2);
+    CHECK(intern(table, "alice") == alice);
+    CHECK(intern_lookup(table, "bob") == bob);
+    CHECK(intern_lookup(table, "carol") == INVALID_ID);
+    CHECK(table->count == 2);
+
+    CHECK(strcmp(intern_name(table, alice), "alice") == 0);
+    CHECK(intern_name(table, INVALID_ID) == NULL);
+    CHECK(intern_name(table, 3) == NULL);
+    intern_table_destroy(table);
+}
+
+// The table keeps its own copy of each name, and growing the ID array
+// must not move the copies handed out earlier
+static void test_names_survive_growth() {
+    intern_table_t *table = intern_table_create();
+    char name[32];
+    strcpy(name, "first");
+    uint32_t first = intern(table, name);
+    const char *first_name = intern_name(table, first);
+    strcpy(name, "changed");
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "user%d", i);
+        CHECK(intern(table, name) == (uint32_t)i + 2);
+    }
+    CHECK(intern_name(table, first) == first_name);
+    CHECK(strcmp(first_name, "first") == 0);
+    CHECK(intern_lookup(table, "first") == first);
+    CHECK(strcmp(intern_name(table, 1001), "user999") == 0);
+    CHECK(intern_lookup(table, "user500") == 502);
+    intern_table_destroy(table);
+}
+
+int main() {
+    test_ids_are_dense_and_stable();
+    test_names_survive_growth();
+    return test_finish("intern");
+}
@@ -0,0 +1,61 @@
+#include "test.h"
+#include "../server/password.h"
+#include <string.h>
+
+// Records built from PBKDF2-HMAC-SHA256 reference outputs (Python's
+// hashlib.pbkdf2_hmac) with the salt "saltSALTsaltSALT"; the last password
+// is longer than a SHA-256 block, so HMAC has to hash it into its key
+static const struct {
+    const char *password;
+    const char *record;
+} known_answers[] = {
+    { "password",
+      "pbkdf2$1$73616c7453414c5473616c7453414c54$"
+      "f2e34bd950e91cf37d22e1135a399b02a17cb1937554a95319093792769f8975" },
+    { "password",
+      "pbkdf2$4096$73616c7453414c5473616c7453414c54$"
+      "9150fa34ce258f3fa0f49507e456a9a71924f682d42f36482b2618848fd38e5a" },
+    { "passwordPASSWORDpasswordPASSWORDpasswordPASSWORDpasswordPASSWORDpassword",
+      "pbkdf2$2$73616c7453414c5473616c7453414c54$"
+      "9bf470647d72ed3ea2855606e32a7c9dbd7dd78533ad551882bbe8a2e64f8788" },
+};
+
+static void test_known_answers() {
+    for (size_t i = 0; i < sizeof(known_answers) / sizeof(known_answers[0]); i++) {
+        CHECK(password_verify(known_answers[i].password, known_answers[i].record) == 1);
+        CHECK(password_verify("Password", known_answers[i].record) == 0);
+    }
+}
+
+static void test_hash_round_trip() {
+    char first[PASSWORD_RECORD_LEN];
+    char second[PASSWORD_RECORD_LEN];
+    CHECK(password_hash("hunter2", 1000, first) == 0);
+    CHECK(password_hash("hunter2", 1000, second) == 0);
+    CHECK(strncmp(first, "pbkdf2$1000$", 12) == 0);
+    CHECK(strcmp(first, second) != 0); // Fresh salt each time
+
+    CHECK(password_verify("hunter2", first) == 1);
+    CHECK(password_verify("hunter2", second) == 1);
+    CHECK(password_verify("hunter3", first) == 0);
+    CHECK(password_verify("", first) == 0);
+}
+
+static void test_malformed_and_legacy_records() {
+    CHECK(password_verify("password", "pbkdf2$0$73616c7453414c5473616c7453414c54$"
+                          "f2e34bd950e91cf37d22e1135a399b02a17cb1937554a95319093792769f8975") == 0);
+    CHECK(password_verify("password", "pbkdf2$1$7361$f2e3") == 0);
+    CHECK(password_verify("password", "pbkdf2$") == 0);
+
+    // Plaintext entries from older users.dat files
+    CHECK(password_verify("secret", "secret") == 1);
+    CHECK(password_verify("secret", "secret2") == 0);
+    CHECK(password_verify("secre", "secret") == 0);
+}
+
+int main() {
+    test_known_answers();
+    test_hash_round_trip();
+    test_malformed_and_legacy_records();
+    return test_finish("password");
+}
@@ -0,0 +1,107 @@
+#include "test.h"
+#include "../server/timer.h"
+
+typedef struct {
+    wheel_timer_t timer;  // First, so the fire callback can cast back
+    int fired;
+    uint64_t fired_at;
+    uint64_t period;      // Re-arm with this delay when non-zero
+} test_timer_t;
+
+static void on_fire(wheel_timer_t *timer) {
+    test_timer_t *t = (test_timer_t*)timer;
+    t->fired++;
+    t->fired_at = timer_now();
+    if (t->period) {
+        timer_schedule(timer, t->period);
+    }
+}
+
+static void arm(test_timer_t *t, uint64_t delay_ms) {
+    t->timer.next = NULL;
+    t->timer.pprev = NULL;
+    t->timer.fire = on_fire;
+    t->fired = 0;
+    t->period = 0;
+    timer_schedule(&t->timer, delay_ms);
+}
+
+// A timer on each level, plus one beyond the top that is parked and re-filed.
+// Each must fire within a tick after its deadline and not before it, which
+// takes the upper levels cascading down correctly.
+static void test_cascade() {
+    static const uint64_t delays[] = {
+        250,                         // Level 0
+        10 * 1000,                   // Level 1: 100 ticks
+        500 * 1000,                  // Level 2: 5000 ticks
+        8ull * 3600 * 1000,          // Level 3: 288000 ticks
+        20ull * 24 * 3600 * 1000,    // Past the top level (about 19 days)
+    };
+    enum { COUNT = sizeof(delays) / sizeof(delays[0]) };
+
+    timer_wheel_init();
+    uint64_t start = timer_now();
+    test_timer_t timers[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        arm(&timers[i], delays[i]);
+    }
+
+    for (int i = 0; i < COUNT; i++) {
+        uint64_t deadline = start + delays[i];
+        timer_advance_to(deadline - TIMER_TICK_MS);
+        CHECK(timers[i].fired == 0);
+
+        timer_advance_to(deadline + TIMER_TICK_MS);
+        CHECK(timers[i].fired == 1);
+        CHECK(timers[i].fired_at >= deadline);
+        for (int j = i + 1; j < COUNT; j++) {
+            CHECK(timers[j].fired == 0);
+        }
+    }
+    CHECK(timer_next_timeout() == -1);
+    timer_wheel_destroy();
+}
+
+static void test_cancel_and_rearm() {
+    timer_wheel_init();
+    uint64_t start = timer_now();
+    CHECK(timer_next_timeout() == -1);
+
+    test_timer_t cancelled;
+    test_timer_t moved;
+    test_timer_t periodic;
+    arm(&cancelled, 1000);
+    arm(&moved, 1000);
+    arm(&periodic, 500);
+    periodic.period = 500;
+    CHECK(timer_next_timeout() > 0 && timer_next_timeout() <= 500 + TIMER_TICK_MS);
+
+    timer_cancel(&cancelled.timer);
+    timer_cancel(&cancelled.timer); // Cancelling twice is harmless
+    timer_schedule(&moved.timer, 100 * 1000);
+
+    // Tick by tick, as the reactor would, so the periodic timer re-arms from
+    // each firing; it fires every five or six ticks depending on where in a
+    // tick the wheel started
+    for (uint64_t now = start; now <= start + 2100; now += TIMER_TICK_MS) {
+        timer_advance_to(now);
+    }
+    CHECK(cancelled.fired == 0);
+    CHECK(moved.fired == 0);
+    CHECK(periodic.fired >= 3 && periodic.fired <= 4);
+    CHECK(periodic.fired_at >= start + 500 * (uint64_t)periodic.fired);
+
+    timer_advance_to(start + 100 * 1000 + TIMER_TICK_MS);
+    CHECK(cancelled.fired == 0);
+    CHECK(moved.fired == 1);
+
+    timer_cancel(&periodic.timer);
+    CHECK(timer_next_timeout() == -1);
+    timer_wheel_destroy();
+}
+
+int main() {
+    test_cascade();
+    test_cancel_and_rearm();
+    return test_finish("timer");
+}